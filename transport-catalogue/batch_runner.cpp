@@ -0,0 +1,126 @@
+#include "batch_runner.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+namespace transport_catalogue {
+	namespace json_handler {
+
+		using namespace std::literals;
+		namespace fs = std::filesystem;
+
+		namespace {
+			std::vector<fs::path> ListInputs(const std::vector<std::string>& inputs) {
+				std::vector<fs::path> files;
+				for (const std::string& input : inputs) {
+					if (!fs::is_directory(input)) {
+						files.emplace_back(input);
+						continue;
+					}
+					const size_t first = files.size();
+					for (const fs::directory_entry& entry : fs::directory_iterator(input)) {
+						if (entry.is_regular_file() && entry.path().extension() == ".json"sv) {
+							files.push_back(entry.path());
+						}
+					}
+					// Directory order is arbitrary
+					std::sort(files.begin() + first, files.end());
+				}
+				return files;
+			}
+
+			// The stat_requests array, every request checked; throws naming what is wrong
+			const json::Array& GetStatRequests(const json::Document& document) {
+				const json::Node& root = document.GetRoot();
+				const auto no_requests = std::invalid_argument("no stat_requests array"s);
+				if (!root.IsMap()) {
+					throw no_requests;
+				}
+				const auto it = root.AsMap().find("stat_requests"sv);
+				if (it == root.AsMap().end() || !it->second.IsArray()) {
+					throw no_requests;
+				}
+				const json::Array& requests = it->second.AsArray();
+				for (size_t i = 0; i < requests.size(); ++i) {
+					try {
+						CheckStatRequest(requests[i]);
+					}
+					catch (const std::invalid_argument& e) {
+						throw std::invalid_argument("stat_requests["s + std::to_string(i) + "]: "s + e.what());
+					}
+				}
+				return requests;
+			}
+
+			void ProcessFile(const BaseSnapshot& base, const fs::path& input_path, const fs::path& output_path) {
+				std::ifstream input(input_path);
+				if (!input) {
+					throw std::runtime_error("cannot open input");
+				}
+				const json::Document document = json::Load(input);
+				const json::Array& requests = GetStatRequests(document);
+
+				// Written beside the output and renamed, so that an output file is never half
+				// written; on any failure the temporary file is removed
+				fs::path temp_path = output_path;
+				temp_path += ".tmp"sv;
+				try {
+					{
+						std::ofstream output(temp_path);
+						output << std::setprecision(6) << std::fixed;
+						base.ProcessStatRequests(requests, output);
+						if (!output.flush()) {
+							throw std::runtime_error("cannot write output");
+						}
+					}
+					fs::rename(temp_path, output_path);
+				}
+				catch (...) {
+					std::error_code ignored;
+					fs::remove(temp_path, ignored);
+					throw;
+				}
+			}
+		}
+
+		size_t RunBatch(const BaseSnapshot& base, const BatchSettings& settings, std::ostream& errors) {
+			const std::vector<fs::path> inputs = ListInputs(settings.inputs);
+			std::vector<fs::path> outputs;
+			outputs.reserve(inputs.size());
+			for (const fs::path& input : inputs) {
+				outputs.push_back(fs::path(settings.output_dir) / input.filename());
+			}
+			std::vector<fs::path> sorted_outputs = outputs;
+			std::sort(sorted_outputs.begin(), sorted_outputs.end());
+			if (std::adjacent_find(sorted_outputs.begin(), sorted_outputs.end()) != sorted_outputs.end()) {
+				throw std::invalid_argument("Two inputs have the same file name");
+			}
+			fs::create_directories(settings.output_dir);
+
+			std::atomic<size_t> failed = 0;
+			std::mutex errors_mutex;
+			concurrency::WorkStealingPool pool(settings.thread_count);
+			// A file at a time per task: files differ in size, and stealing evens that out
+			pool.ParallelFor(inputs.size(), 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					try {
+						ProcessFile(base, inputs[i], outputs[i]);
+					}
+					catch (const std::exception& e) {
+						++failed;
+						std::lock_guard lock(errors_mutex);
+						errors << inputs[i].string() << ": "sv << e.what() << '\n';
+					}
+				}
+			});
+			return failed;
+		}
+
+	} // namespace json_handler
+} // namespace transport_catalogue
@@ -0,0 +1,25 @@
+#pragma once
+#include "stat_server.h"
+
+#include <string>
+#include <vector>
+
+namespace transport_catalogue {
+	namespace json_handler {
+
+		struct BatchSettings {
+			// Request files, and directories whose *.json files are all taken
+			std::vector<std::string> inputs;
+			// Every input gets an output file of the same name here
+			std::string output_dir;
+			// 0 means one thread per hardware thread
+			size_t thread_count = 0;
+		};
+
+		// Answers the stat_requests of many process_requests inputs against one loaded base,
+		// several files at once. A file that fails is reported to errors and skipped; the
+		// others are still answered. Returns the number of files that failed
+		size_t RunBatch(const BaseSnapshot& base, const BatchSettings& settings, std::ostream& errors);
+
+	} // namespace json_handler
+} // namespace transport_catalogue
@@ -0,0 +1,257 @@
+#include "city_generator.h"
+
+#include "geo.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+    using namespace std::literals;
+
+    namespace {
+        constexpr double MIN_LAT = 55.55;
+        constexpr double MIN_LNG = 37.35;
+        constexpr double SPAN = 0.4;
+
+        // SplitMix64: small, fast and the same everywhere
+        class Random {
+        public:
+            explicit Random(uint64_t seed)
+                : state_(seed) {
+            }
+
+            uint64_t Next() {
+                uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                return z ^ (z >> 31);
+            }
+
+            // In [0, 1)
+            double Uniform() {
+                return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+            }
+
+            // In [0, bound)
+            size_t Below(size_t bound) {
+                return static_cast<size_t>(Uniform() * bound);
+            }
+
+            size_t Between(size_t min, size_t max) {
+                return min + Below(max - min + 1);
+            }
+
+        private:
+            uint64_t state_;
+        };
+
+        std::string StopName(size_t index) {
+            return "Stop "s + std::to_string(index);
+        }
+
+        std::string BusName(size_t index) {
+            return "Bus "s + std::to_string(index);
+        }
+
+        struct City {
+            std::vector<geo::Coordinates> stops;
+            size_t grid_side = 1;
+            struct Route {
+                std::vector<size_t> stops;
+                bool is_roundtrip;
+            };
+            std::vector<Route> routes;
+            // Keyed by (from, to)
+            std::map<std::pair<size_t, size_t>, int> distances;
+        };
+
+        size_t RandomNeighbour(const City& city, size_t stop, Random& random) {
+            const size_t side = city.grid_side;
+            const size_t row = stop / side;
+            const size_t column = stop % side;
+            std::vector<size_t> neighbours;
+            for (const auto& [d_row, d_column] : { std::pair(-1, 0), std::pair(1, 0), std::pair(0, -1), std::pair(0, 1) }) {
+                const size_t n_row = row + d_row;
+                const size_t n_column = column + d_column;
+                // Unsigned wrap-around makes -1 huge, so one check covers both edges
+                if (n_row < side && n_column < side && n_row * side + n_column < city.stops.size()) {
+                    neighbours.push_back(n_row * side + n_column);
+                }
+            }
+            return neighbours.empty() ? stop : neighbours[random.Below(neighbours.size())];
+        }
+
+        void AddDistance(City& city, size_t from, size_t to, Random& random) {
+            if (from == to || city.distances.count({ from, to }) || city.distances.count({ to, from })) {
+                return;
+            }
+            const double straight = geo::ComputeDistance(city.stops[from], city.stops[to]);
+            city.distances[{ from, to }] = std::max(1, static_cast<int>(straight * (1.1 + 0.4 * random.Uniform())));
+        }
+
+        City GenerateCity(const CityParameters& parameters) {
+            Random random(parameters.seed);
+            City city;
+            const size_t stop_count = std::max<size_t>(parameters.stop_count, 2);
+            city.grid_side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(stop_count))));
+            const double step = SPAN / city.grid_side;
+            for (size_t i = 0; i < stop_count; ++i) {
+                const double row = static_cast<double>(i / city.grid_side) + 0.3 * random.Uniform();
+                const double column = static_cast<double>(i % city.grid_side) + 0.3 * random.Uniform();
+                city.stops.push_back({ MIN_LAT + row * step, MIN_LNG + column * step });
+            }
+
+            const size_t min_stops = std::max<size_t>(parameters.min_route_stops, 2);
+            const size_t max_stops = std::max(parameters.max_route_stops, min_stops);
+            for (size_t bus = 0; bus < parameters.bus_count; ++bus) {
+                City::Route route;
+                route.is_roundtrip = random.Uniform() < parameters.roundtrip_share;
+                const size_t length = random.Between(min_stops, max_stops);
+                route.stops.push_back(random.Below(stop_count));
+                while (route.stops.size() < length) {
+                    route.stops.push_back(RandomNeighbour(city, route.stops.back(), random));
+                }
+                // A stop is never followed by itself, as the catalogue has no distance for that
+                if (route.is_roundtrip && route.stops.back() != route.stops.front()) {
+                    route.stops.push_back(route.stops.front());
+                }
+                for (size_t i = 1; i < route.stops.size(); ++i) {
+                    AddDistance(city, route.stops[i - 1], route.stops[i], random);
+                }
+                city.routes.push_back(std::move(route));
+            }
+
+            const size_t whole_extras = static_cast<size_t>(parameters.extra_distances_per_stop);
+            const double fractional_extra = parameters.extra_distances_per_stop - whole_extras;
+            for (size_t stop = 0; stop < stop_count; ++stop) {
+                const size_t extras = whole_extras + (random.Uniform() < fractional_extra ? 1 : 0);
+                for (size_t i = 0; i < extras; ++i) {
+                    AddDistance(city, stop, RandomNeighbour(city, stop, random), random);
+                }
+            }
+            return city;
+        }
+
+        void WriteSerializationSettings(json::Writer& writer, const std::string& base_file) {
+            writer.Key("serialization_settings"sv).StartDict()
+                .Key("file"sv).Value(base_file)
+                .EndDict();
+        }
+    }
+
+    std::string GenerateBaseDocument(const CityParameters& parameters, const std::string& base_file) {
+        const City city = GenerateCity(parameters);
+        std::vector<std::vector<std::pair<size_t, int>>> stop_distances(city.stops.size());
+        for (const auto& [stops, distance] : city.distances) {
+            stop_distances[stops.first].emplace_back(stops.second, distance);
+        }
+
+        std::ostringstream output;
+        output.precision(10);
+        {
+            json::Writer writer(output, json::Writer::Format::COMPACT);
+            writer.StartDict();
+            WriteSerializationSettings(writer, base_file);
+            writer.Key("routing_settings"sv).StartDict()
+                .Key("bus_wait_time"sv).Value(6)
+                .Key("bus_velocity"sv).Value(40)
+                .EndDict();
+            writer.Key("render_settings"sv).StartDict()
+                .Key("width"sv).Value(1200.0)
+                .Key("height"sv).Value(1200.0)
+                .Key("padding"sv).Value(50.0)
+                .Key("line_width"sv).Value(14.0)
+                .Key("stop_radius"sv).Value(5.0)
+                .Key("bus_label_font_size"sv).Value(20)
+                .Key("bus_label_offset"sv).StartArray().Value(7.0).Value(15.0).EndArray()
+                .Key("stop_label_font_size"sv).Value(20)
+                .Key("stop_label_offset"sv).StartArray().Value(7.0).Value(-3.0).EndArray()
+                .Key("underlayer_color"sv).StartArray().Value(255).Value(255).Value(255).Value(0.85).EndArray()
+                .Key("underlayer_width"sv).Value(3.0)
+                .Key("color_palette"sv).StartArray()
+                    .Value("green"sv)
+                    .StartArray().Value(255).Value(160).Value(0).EndArray()
+                    .Value("red"sv)
+                    .EndArray()
+                .EndDict();
+
+            writer.Key("base_requests"sv).StartArray();
+            for (size_t stop = 0; stop < city.stops.size(); ++stop) {
+                writer.StartDict()
+                    .Key("type"sv).Value("Stop"sv)
+                    .Key("name"sv).Value(StopName(stop))
+                    .Key("latitude"sv).Value(city.stops[stop].lat)
+                    .Key("longitude"sv).Value(city.stops[stop].lng)
+                    .Key("road_distances"sv).StartDict();
+                for (const auto& [to, distance] : stop_distances[stop]) {
+                    writer.Key(StopName(to)).Value(distance);
+                }
+                writer.EndDict().EndDict();
+            }
+            for (size_t bus = 0; bus < city.routes.size(); ++bus) {
+                const City::Route& route = city.routes[bus];
+                writer.StartDict()
+                    .Key("type"sv).Value("Bus"sv)
+                    .Key("name"sv).Value(BusName(bus))
+                    .Key("stops"sv).StartArray();
+                for (const size_t stop : route.stops) {
+                    writer.Value(StopName(stop));
+                }
+                writer.EndArray()
+                    .Key("is_roundtrip"sv).Value(route.is_roundtrip)
+                    .EndDict();
+            }
+            writer.EndArray();
+            writer.EndDict();
+        }
+        return output.str();
+    }
+
+    std::string GenerateStatDocument(const CityParameters& parameters, const std::string& base_file) {
+        // Its own stream of numbers, so the requests do not change with the city's parameters
+        Random random(parameters.seed ^ 0x5354415453ULL);
+        const size_t stop_count = std::max<size_t>(parameters.stop_count, 2);
+        const RequestMix& mix = parameters.mix;
+        const double total = mix.stop + mix.bus + mix.route + mix.map;
+
+        std::ostringstream output;
+        {
+            json::Writer writer(output, json::Writer::Format::COMPACT);
+            writer.StartDict();
+            WriteSerializationSettings(writer, base_file);
+            writer.Key("stat_requests"sv).StartArray();
+            for (size_t id = 1; id <= parameters.request_count; ++id) {
+                writer.StartDict().Key("id"sv).Value(static_cast<int>(id));
+                const double pick = random.Uniform() * total;
+                const bool missing = random.Uniform() < 0.1;
+                if (pick < mix.stop) {
+                    writer.Key("type"sv).Value("Stop"sv)
+                        .Key("name"sv).Value(missing ? "Nowhere"s : StopName(random.Below(stop_count)));
+                }
+                else if (pick < mix.stop + mix.bus && parameters.bus_count > 0) {
+                    writer.Key("type"sv).Value("Bus"sv)
+                        .Key("name"sv).Value(missing ? "Ghost bus"s : BusName(random.Below(parameters.bus_count)));
+                }
+                else if (pick < mix.stop + mix.bus + mix.route) {
+                    writer.Key("type"sv).Value("Route"sv)
+                        .Key("from"sv).Value(StopName(random.Below(stop_count)))
+                        .Key("to"sv).Value(StopName(random.Below(stop_count)));
+                }
+                else {
+                    writer.Key("type"sv).Value("Map"sv);
+                }
+                writer.EndDict();
+            }
+            writer.EndArray();
+            writer.EndDict();
+        }
+        return output.str();
+    }
+
+}  // namespace bench
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bench {
+
+    // Shares of the stat request types; they need not add up to one
+    struct RequestMix {
+        double stop = 0.3;
+        double bus = 0.3;
+        double route = 0.38;
+        double map = 0.02;
+    };
+
+    struct CityParameters {
+        uint64_t seed = 1;
+        size_t stop_count = 2000;
+        size_t bus_count = 200;
+        // Stops per route, before a round trip returns to its first stop
+        size_t min_route_stops = 5;
+        size_t max_route_stops = 40;
+        // Road distances per stop given besides those the routes need
+        double extra_distances_per_stop = 1.0;
+        double roundtrip_share = 0.5;
+        size_t request_count = 5000;
+        RequestMix mix;
+    };
+
+    // A synthetic city: stops on a jittered street grid, routes walking along the grid, road
+    // distances a little longer than the straight line. The same parameters give the same
+    // text on every platform: nothing depends on the standard library's distributions
+
+    // The make_base input
+    std::string GenerateBaseDocument(const CityParameters& parameters, const std::string& base_file);
+    // The process_requests input. About a tenth of the Stop and Bus requests name something
+    // that does not exist
+    std::string GenerateStatDocument(const CityParameters& parameters, const std::string& base_file);
+
+}  // namespace bench
@@ -0,0 +1,267 @@
+// End-to-end timing of the make_base and process_requests stages on a synthetic city.
+// Usage: e2e_benchmark [--stops N] [--buses N] [--min-route N] [--max-route N]
+//     [--extra-distances X] [--roundtrip-share X] [--requests N] [--mix STOP,BUS,ROUTE,MAP]
+//     [--seed N] [--repeat N] [--threads N] [--base-file PATH] [--output PATH]
+// Prints the results as JSON; build with -DCMAKE_BUILD_TYPE=Release for meaningful numbers
+
+#include "city_generator.h"
+#include "statistics.h"
+
+#include "json_reader.h"
+#include "serialization.h"
+#include "thread_pool.h"
+#include "transport_catalogue.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef BENCHMARK_BUILD_TYPE
+#define BENCHMARK_BUILD_TYPE ""
+#endif
+
+using namespace std::literals;
+using namespace transport_catalogue;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        bench::CityParameters city;
+        size_t repeat = 3;
+        // 0 runs the serial make_base path
+        size_t thread_count = 0;
+        std::string base_file = "e2e_benchmark.db";
+        std::string output_file;
+    };
+
+    std::optional<Options> ParseOptions(int argc, const char** argv) {
+        Options options;
+        try {
+            for (int i = 1; i < argc; ++i) {
+                const std::string_view arg(argv[i]);
+                if (i + 1 == argc) {
+                    return std::nullopt;
+                }
+                const std::string value(argv[++i]);
+                if (arg == "--stops"sv) {
+                    options.city.stop_count = std::stoul(value);
+                }
+                else if (arg == "--buses"sv) {
+                    options.city.bus_count = std::stoul(value);
+                }
+                else if (arg == "--min-route"sv) {
+                    options.city.min_route_stops = std::stoul(value);
+                }
+                else if (arg == "--max-route"sv) {
+                    options.city.max_route_stops = std::stoul(value);
+                }
+                else if (arg == "--extra-distances"sv) {
+                    options.city.extra_distances_per_stop = std::stod(value);
+                }
+                else if (arg == "--roundtrip-share"sv) {
+                    options.city.roundtrip_share = std::stod(value);
+                }
+                else if (arg == "--requests"sv) {
+                    options.city.request_count = std::stoul(value);
+                }
+                else if (arg == "--mix"sv) {
+                    bench::RequestMix& mix = options.city.mix;
+                    char separator = 0;
+                    std::istringstream shares(value);
+                    if (!(shares >> mix.stop >> separator >> mix.bus >> separator >> mix.route >> separator >> mix.map)) {
+                        return std::nullopt;
+                    }
+                }
+                else if (arg == "--seed"sv) {
+                    options.city.seed = std::stoull(value);
+                }
+                else if (arg == "--repeat"sv) {
+                    options.repeat = std::max<size_t>(1, std::stoul(value));
+                }
+                else if (arg == "--threads"sv) {
+                    options.thread_count = std::stoul(value);
+                }
+                else if (arg == "--base-file"sv) {
+                    options.base_file = value;
+                }
+                else if (arg == "--output"sv) {
+                    options.output_file = value;
+                }
+                else {
+                    return std::nullopt;
+                }
+            }
+        }
+        catch (const std::exception&) {
+            return std::nullopt;
+        }
+        return options;
+    }
+
+    double MicrosecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    // Runs action and adds its time to the samples of stage
+    template <typename Action>
+    void TimeStage(std::map<std::string, std::vector<double>>& stages, const std::string& stage, Action action) {
+        const Clock::time_point start = Clock::now();
+        action();
+        stages[stage].push_back(MicrosecondsSince(start));
+    }
+
+    struct Results {
+        // In the order they run
+        std::vector<std::string> stage_order;
+        std::map<std::string, std::vector<double>> stages;
+        std::map<std::string, std::vector<double>> requests;
+        size_t vertex_count = 0;
+        size_t edge_count = 0;
+        size_t base_size = 0;
+        size_t input_size = 0;
+    };
+
+    void RunOnce(const Options& options, const std::string& base_text, const std::string& stat_text, Results& results) {
+        std::unique_ptr<concurrency::WorkStealingPool> pool;
+        if (options.thread_count > 0) {
+            pool = std::make_unique<concurrency::WorkStealingPool>(options.thread_count);
+        }
+
+        // make_base
+        {
+            TransportCatalogue catalogue;
+            json_handler::JsonReader reader(catalogue);
+            std::istringstream input(base_text);
+            TimeStage(results.stages, "json_parse", [&] { reader.LoadJSON(input); });
+            TimeStage(results.stages, "process_base_requests", [&] {
+                pool ? reader.AddBaseRequests(*pool) : reader.AddBaseRequests();
+            });
+            TimeStage(results.stages, "build_graph", [&] {
+                pool ? catalogue.BuildGraph(*pool) : catalogue.BuildGraph();
+            });
+            TimeStage(results.stages, "freeze", [&] { catalogue.Freeze(); });
+            TimeStage(results.stages, "serialize", [&] { Serialize(catalogue, options.base_file, false, pool.get()); });
+            results.vertex_count = catalogue.GetGraphConstRef().GetVertexCount();
+            results.edge_count = catalogue.GetGraphConstRef().GetEdgeCount();
+        }
+
+        // process_requests
+        TransportCatalogue catalogue;
+        json_handler::JsonReader reader(catalogue);
+        std::istringstream input(stat_text);
+        TimeStage(results.stages, "stat_json_parse", [&] { reader.LoadJSON(input); });
+        TimeStage(results.stages, "deserialize", [&] { Deserialize(options.base_file, catalogue); });
+        std::unique_ptr<json_handler::JsonReader::Router> router;
+        TimeStage(results.stages, "router", [&] {
+            router = std::make_unique<json_handler::JsonReader::Router>(catalogue.GetGraphConstRef());
+        });
+
+        std::ostringstream number_format;
+        number_format << std::setprecision(6) << std::fixed;
+        std::string response;
+        const json::Document stat_document = json::Load(stat_text);
+        const Clock::time_point requests_start = Clock::now();
+        for (const json::Node& request : stat_document.GetRoot().AsMap().at("stat_requests"sv).AsArray()) {
+            response.clear();
+            json::Writer writer(response, number_format, json::Writer::Format::COMPACT);
+            const Clock::time_point start = Clock::now();
+            reader.ProcessStatRequest(request.AsMap(), *router, writer);
+            results.requests[request.AsMap().at("type"sv).AsString()].push_back(MicrosecondsSince(start));
+        }
+        results.stages["stat_requests"].push_back(MicrosecondsSince(requests_start));
+
+        std::ifstream base(options.base_file, std::ios::binary | std::ios::ate);
+        results.base_size = static_cast<size_t>(base.tellg());
+    }
+
+    void WriteResults(std::ostream& output, const Options& options, const Results& results) {
+        const bench::CityParameters& city = options.city;
+        output << std::setprecision(3) << std::fixed;
+        json::Writer writer(output);
+        writer.StartDict()
+            .Key("benchmark"sv).Value("e2e"sv)
+            .Key("build_type"sv).Value(BENCHMARK_BUILD_TYPE ""sv);
+        writer.Key("parameters"sv).StartDict()
+            .Key("seed"sv).Value(static_cast<uint64_t>(city.seed))
+            .Key("stops"sv).Value(static_cast<uint64_t>(city.stop_count))
+            .Key("buses"sv).Value(static_cast<uint64_t>(city.bus_count))
+            .Key("min_route_stops"sv).Value(static_cast<uint64_t>(city.min_route_stops))
+            .Key("max_route_stops"sv).Value(static_cast<uint64_t>(city.max_route_stops))
+            .Key("extra_distances_per_stop"sv).Value(city.extra_distances_per_stop)
+            .Key("roundtrip_share"sv).Value(city.roundtrip_share)
+            .Key("requests"sv).Value(static_cast<uint64_t>(city.request_count))
+            .Key("mix"sv).StartDict()
+                .Key("Stop"sv).Value(city.mix.stop)
+                .Key("Bus"sv).Value(city.mix.bus)
+                .Key("Route"sv).Value(city.mix.route)
+                .Key("Map"sv).Value(city.mix.map)
+                .EndDict()
+            .Key("repeat"sv).Value(static_cast<uint64_t>(options.repeat))
+            .Key("threads"sv).Value(static_cast<uint64_t>(options.thread_count))
+            .EndDict();
+        writer.Key("sizes"sv).StartDict()
+            .Key("make_base_input_bytes"sv).Value(static_cast<uint64_t>(results.input_size))
+            .Key("base_bytes"sv).Value(static_cast<uint64_t>(results.base_size))
+            .Key("vertices"sv).Value(static_cast<uint64_t>(results.vertex_count))
+            .Key("edges"sv).Value(static_cast<uint64_t>(results.edge_count))
+            .EndDict();
+        // One sample per repetition
+        writer.Key("stages"sv).StartDict();
+        for (const std::string& stage : results.stage_order) {
+            writer.Key(stage);
+            bench::WriteSummary(writer, bench::Summarize(results.stages.at(stage)));
+        }
+        writer.EndDict();
+        // One sample per request, over all repetitions; the first Map of each renders the map
+        writer.Key("requests"sv).StartDict();
+        for (const auto& [type, samples] : results.requests) {
+            writer.Key(type);
+            bench::WriteSummary(writer, bench::Summarize(samples));
+        }
+        writer.EndDict();
+        writer.EndDict();
+        writer.Flush();
+        output << '\n';
+    }
+}
+
+int main(int argc, const char** argv) {
+    const std::optional<Options> options = ParseOptions(argc, argv);
+    if (!options) {
+        std::cerr << "Usage: e2e_benchmark [--stops N] [--buses N] [--min-route N] [--max-route N]"
+                     " [--extra-distances X] [--roundtrip-share X] [--requests N] [--mix STOP,BUS,ROUTE,MAP]"
+                     " [--seed N] [--repeat N] [--threads N] [--base-file PATH] [--output PATH]\n"sv;
+        return 1;
+    }
+
+    const std::string base_text = bench::GenerateBaseDocument(options->city, options->base_file);
+    const std::string stat_text = bench::GenerateStatDocument(options->city, options->base_file);
+
+    Results results;
+    results.input_size = base_text.size();
+    results.stage_order = { "json_parse"s, "process_base_requests"s, "build_graph"s, "freeze"s, "serialize"s,
+                            "stat_json_parse"s, "deserialize"s, "router"s, "stat_requests"s };
+    for (size_t i = 0; i < options->repeat; ++i) {
+        RunOnce(*options, base_text, stat_text, results);
+    }
+    std::remove(options->base_file.c_str());
+
+    if (options->output_file.empty()) {
+        WriteResults(std::cout, *options, results);
+    }
+    else {
+        std::ofstream output(options->output_file);
+        WriteResults(output, *options, results);
+    }
+    return 0;
+}
@@ -0,0 +1,366 @@
+// Timing of the core kernels one at a time, on data from a synthetic city.
+// Usage: micro_benchmark [--stops N] [--buses N] [--seed N] [--samples N] [--warmup N]
+//     [--min-sample-us X] [--filter TEXT] [--output PATH]
+// Every case is first calibrated: its batch size doubles until one batch takes at least
+// min-sample-us. Then warmup batches are run and thrown away, and samples batches are
+// timed. Prints the time per call, in nanoseconds, as JSON; build with
+// -DCMAKE_BUILD_TYPE=Release for meaningful numbers
+
+#include "city_generator.h"
+#include "statistics.h"
+
+#include "geo.h"
+#include "json.h"
+#include "json_reader.h"
+#include "serialization.h"
+#include "svg.h"
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef BENCHMARK_BUILD_TYPE
+#define BENCHMARK_BUILD_TYPE ""
+#endif
+
+using namespace std::literals;
+using namespace transport_catalogue;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        bench::CityParameters city;
+        size_t sample_count = 30;
+        size_t warmup_count = 3;
+        double min_sample_us = 1000.0;
+        // Only the cases whose name contains it
+        std::string filter;
+        std::string output_file;
+    };
+
+    std::optional<Options> ParseOptions(int argc, const char** argv) {
+        Options options;
+        // Small enough for the router table to be built in a moment
+        options.city.stop_count = 500;
+        options.city.bus_count = 50;
+        try {
+            for (int i = 1; i < argc; ++i) {
+                const std::string_view arg(argv[i]);
+                if (i + 1 == argc) {
+                    return std::nullopt;
+                }
+                const std::string value(argv[++i]);
+                if (arg == "--stops"sv) {
+                    options.city.stop_count = std::stoul(value);
+                }
+                else if (arg == "--buses"sv) {
+                    options.city.bus_count = std::stoul(value);
+                }
+                else if (arg == "--seed"sv) {
+                    options.city.seed = std::stoull(value);
+                }
+                else if (arg == "--samples"sv) {
+                    options.sample_count = std::max<size_t>(1, std::stoul(value));
+                }
+                else if (arg == "--warmup"sv) {
+                    options.warmup_count = std::stoul(value);
+                }
+                else if (arg == "--min-sample-us"sv) {
+                    options.min_sample_us = std::stod(value);
+                }
+                else if (arg == "--filter"sv) {
+                    options.filter = value;
+                }
+                else if (arg == "--output"sv) {
+                    options.output_file = value;
+                }
+                else {
+                    return std::nullopt;
+                }
+            }
+        }
+        catch (const std::exception&) {
+            return std::nullopt;
+        }
+        return options;
+    }
+
+    // Makes the compiler treat value as used, so the work producing it is not optimized away
+    template <typename T>
+    void KeepAlive(const T& value) {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    struct CaseResult {
+        std::string name;
+        size_t batch = 0;
+        bench::Summary summary;
+    };
+
+    class Suite {
+    public:
+        explicit Suite(const Options& options)
+            : options_(options) {
+        }
+
+        // body(i) is one call; i counts every call of the case, so that the body can
+        // walk its inputs
+        template <typename Body>
+        void Run(const std::string& name, Body body) {
+            if (name.find(options_.filter) == std::string::npos) {
+                return;
+            }
+            size_t iteration = 0;
+            auto time_batch = [&body, &iteration](size_t batch) {
+                const Clock::time_point start = Clock::now();
+                for (size_t i = 0; i < batch; ++i) {
+                    body(iteration++);
+                }
+                return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            };
+
+            const double min_sample_ns = options_.min_sample_us * 1000.0;
+            size_t batch = 1;
+            while (time_batch(batch) < min_sample_ns && batch < MAX_BATCH) {
+                batch *= 2;
+            }
+            for (size_t i = 0; i < options_.warmup_count; ++i) {
+                time_batch(batch);
+            }
+            std::vector<double> samples;
+            samples.reserve(options_.sample_count);
+            for (size_t i = 0; i < options_.sample_count; ++i) {
+                samples.push_back(time_batch(batch) / batch);
+            }
+            results_.push_back({ name, batch, bench::Summarize(std::move(samples)) });
+        }
+
+        const std::vector<CaseResult>& GetResults() const {
+            return results_;
+        }
+
+    private:
+        static constexpr size_t MAX_BATCH = 1 << 24;
+
+        const Options& options_;
+        std::vector<CaseResult> results_;
+    };
+
+    // The stops as circles with names and the buses as lines, the way the map draws them
+    svg::Document MakeScene(const TransportCatalogue& catalogue) {
+        const std::deque<Stop>& stops = catalogue.GetStops();
+        double min_lat = stops.front().coords.lat;
+        double max_lat = min_lat;
+        double min_lng = stops.front().coords.lng;
+        double max_lng = min_lng;
+        for (const Stop& stop : stops) {
+            min_lat = std::min(min_lat, stop.coords.lat);
+            max_lat = std::max(max_lat, stop.coords.lat);
+            min_lng = std::min(min_lng, stop.coords.lng);
+            max_lng = std::max(max_lng, stop.coords.lng);
+        }
+        const double scale = 1000.0 / std::max({ max_lat - min_lat, max_lng - min_lng, 1e-9 });
+        auto project = [=](const geo::Coordinates& coords) {
+            return svg::Point{ (coords.lng - min_lng) * scale, (max_lat - coords.lat) * scale };
+        };
+
+        svg::Document document;
+        for (const Bus& bus : catalogue.GetBuses()) {
+            svg::Polyline line;
+            line.SetStrokeColor("green"s).SetFillColor("none"s).SetStrokeWidth(14.0)
+                .SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+            for (const Stop* stop : bus.stops) {
+                line.AddPoint(project(stop->coords));
+            }
+            document.Add(std::move(line));
+        }
+        for (const Stop& stop : stops) {
+            document.Add(svg::Circle().SetCenter(project(stop.coords)).SetRadius(5.0).SetFillColor("white"s));
+        }
+        for (const Stop& stop : stops) {
+            document.Add(svg::Text().SetPosition(project(stop.coords)).SetOffset({ 7.0, -3.0 }).SetFontSize(20)
+                .SetFontFamily("Verdana"s).SetFillColor("black"s).SetData(stop.name));
+        }
+        return document;
+    }
+
+    void RunCases(Suite& suite, const Options& options) {
+        const std::string base_text = bench::GenerateBaseDocument(options.city, "micro_benchmark.db"s);
+        const std::string stat_text = bench::GenerateStatDocument(options.city, "micro_benchmark.db"s);
+
+        TransportCatalogue catalogue;
+        json_handler::JsonReader reader(catalogue);
+        {
+            std::istringstream input(base_text);
+            reader.LoadJSON(input);
+        }
+        reader.ProcessBaseRequests();
+        const auto& graph = catalogue.GetGraphConstRef();
+        const json_handler::JsonReader::Router router(graph);
+
+        // Inputs are drawn once, up front, and walked in a loop by the cases
+        std::mt19937_64 random(options.city.seed);
+        auto shuffled = [&random](auto values) {
+            std::shuffle(values.begin(), values.end(), random);
+            return values;
+        };
+        std::vector<const Stop*> stops;
+        std::vector<std::string_view> stop_names;
+        for (const Stop& stop : catalogue.GetStops()) {
+            stops.push_back(&stop);
+            stop_names.push_back(stop.name);
+        }
+        stop_names = shuffled(std::move(stop_names));
+        std::vector<std::pair<const Stop*, const Stop*>> stop_pairs;
+        for (const auto& [stop_pair, distance] : catalogue.GetDistances()) {
+            stop_pairs.push_back(stop_pair);
+        }
+        std::sort(stop_pairs.begin(), stop_pairs.end(), [](const auto& lhs, const auto& rhs) {
+            return std::pair(lhs.first->id, lhs.second->id) < std::pair(rhs.first->id, rhs.second->id);
+        });
+        stop_pairs = shuffled(std::move(stop_pairs));
+        std::vector<std::pair<graph::VertexId, graph::VertexId>> vertex_pairs;
+        for (size_t i = 0; i < 4096; ++i) {
+            vertex_pairs.emplace_back(random() % graph.GetVertexCount(), random() % graph.GetVertexCount());
+        }
+        std::vector<std::string> text_data;
+        for (size_t i = 0; i < 64; ++i) {
+            const std::string& name = stops[random() % stops.size()]->name;
+            text_data.push_back(i % 4 == 0 ? name : "\"" + name + "\" & <" + name + "> 'express'");
+        }
+
+        // json
+        const json::Document base_document = json::Load(base_text);
+        suite.Run("json::Load base document"s, [&](size_t) {
+            json::Document document = json::Load(base_text);
+            KeepAlive(document);
+        });
+        suite.Run("json::Load stat document"s, [&](size_t) {
+            json::Document document = json::Load(stat_text);
+            KeepAlive(document);
+        });
+        std::ostringstream json_output;
+        suite.Run("json::Print base document"s, [&](size_t) {
+            json_output.str({});
+            json::Print(base_document, json_output);
+            KeepAlive(json_output);
+        });
+
+        // svg
+        const svg::Document scene = MakeScene(catalogue);
+        std::ostringstream svg_output;
+        suite.Run("svg::Document::Render"s, [&](size_t) {
+            svg_output.str({});
+            scene.Render(svg_output);
+            KeepAlive(svg_output);
+        });
+        // Text keeps its data cleaned up, so CleanUpString is timed through SetData
+        suite.Run("svg::Text::CleanUpString"s, [&](size_t i) {
+            svg::Text text;
+            text.SetData(text_data[i % text_data.size()]);
+            KeepAlive(text);
+        });
+
+        // geo
+        suite.Run("geo::ComputeDistance"s, [&](size_t i) {
+            const auto& [from, to] = stop_pairs[i % stop_pairs.size()];
+            const double distance = geo::ComputeDistance(from->coords, to->coords);
+            KeepAlive(distance);
+        });
+
+        // catalogue
+        suite.Run("TransportCatalogue::GetDistance"s, [&](size_t i) {
+            const auto& [from, to] = stop_pairs[i % stop_pairs.size()];
+            const double distance = catalogue.GetDistance(from, to);
+            KeepAlive(distance);
+        });
+        suite.Run("TransportCatalogue::FindStop"s, [&](size_t i) {
+            const Stop* stop = catalogue.FindStop(stop_names[i % stop_names.size()]);
+            KeepAlive(stop);
+        });
+        suite.Run("TransportCatalogue::GetBusesByStop"s, [&](size_t i) {
+            const auto& buses = catalogue.GetBusesByStop(stop_names[i % stop_names.size()]);
+            KeepAlive(buses);
+        });
+
+        // router
+        suite.Run("Router::BuildRoute"s, [&](size_t i) {
+            const auto& [from, to] = vertex_pairs[i % vertex_pairs.size()];
+            const auto route = router.BuildRoute(from, to);
+            KeepAlive(route);
+        });
+
+        // serialization
+        const transport_catalogue_serialize::DirectedWeightedGraph packed_graph = detail::PackGraph(graph);
+        suite.Run("serialization::PackGraph"s, [&](size_t) {
+            const auto packed = detail::PackGraph(graph);
+            KeepAlive(packed);
+        });
+        suite.Run("serialization::UnpackGraph"s, [&](size_t) {
+            const auto unpacked = detail::UnpackGraph(packed_graph, graph.GetVertexCount());
+            KeepAlive(unpacked);
+        });
+    }
+
+    void WriteResults(std::ostream& output, const Options& options, const std::vector<CaseResult>& results) {
+        output << std::setprecision(3) << std::fixed;
+        json::Writer writer(output);
+        writer.StartDict()
+            .Key("benchmark"sv).Value("micro"sv)
+            .Key("build_type"sv).Value(BENCHMARK_BUILD_TYPE ""sv);
+        writer.Key("parameters"sv).StartDict()
+            .Key("seed"sv).Value(static_cast<uint64_t>(options.city.seed))
+            .Key("stops"sv).Value(static_cast<uint64_t>(options.city.stop_count))
+            .Key("buses"sv).Value(static_cast<uint64_t>(options.city.bus_count))
+            .Key("samples"sv).Value(static_cast<uint64_t>(options.sample_count))
+            .Key("warmup"sv).Value(static_cast<uint64_t>(options.warmup_count))
+            .Key("min_sample_us"sv).Value(options.min_sample_us)
+            .EndDict();
+        // One sample per timed batch: the batch's time divided by its calls
+        writer.Key("cases"sv).StartDict();
+        for (const CaseResult& result : results) {
+            writer.Key(result.name).StartDict()
+                .Key("batch"sv).Value(static_cast<uint64_t>(result.batch))
+                .Key("per_call"sv);
+            bench::WriteSummary(writer, result.summary, "ns"sv);
+            writer.EndDict();
+        }
+        writer.EndDict();
+        writer.EndDict();
+        writer.Flush();
+        output << '\n';
+    }
+}
+
+int main(int argc, const char** argv) {
+    const std::optional<Options> options = ParseOptions(argc, argv);
+    if (!options) {
+        std::cerr << "Usage: micro_benchmark [--stops N] [--buses N] [--seed N] [--samples N] [--warmup N]"
+                     " [--min-sample-us X] [--filter TEXT] [--output PATH]\n"sv;
+        return 1;
+    }
+
+    Suite suite(*options);
+    RunCases(suite, *options);
+
+    if (options->output_file.empty()) {
+        WriteResults(std::cout, *options, suite.GetResults());
+    }
+    else {
+        std::ofstream output(options->output_file);
+        WriteResults(output, *options, suite.GetResults());
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <string>
+
+namespace bench {
+
+    using namespace std::literals;
+
+    Summary Summarize(std::vector<double> samples) {
+        Summary summary;
+        if (samples.empty()) {
+            return summary;
+        }
+        std::sort(samples.begin(), samples.end());
+        const auto percentile = [&samples](double share) {
+            const size_t rank = static_cast<size_t>(std::ceil(share * samples.size()));
+            return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+        };
+        summary.count = samples.size();
+        summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+        summary.min = samples.front();
+        summary.p50 = percentile(0.5);
+        summary.p90 = percentile(0.9);
+        summary.p99 = percentile(0.99);
+        summary.max = samples.back();
+        return summary;
+    }
+
+    void WriteSummary(json::Writer& writer, const Summary& summary, std::string_view unit) {
+        const std::string suffix = "_"s.append(unit);
+        writer.StartDict()
+            .Key("count"sv).Value(static_cast<uint64_t>(summary.count))
+            .Key("mean"s + suffix).Value(summary.mean)
+            .Key("min"s + suffix).Value(summary.min)
+            .Key("p50"s + suffix).Value(summary.p50)
+            .Key("p90"s + suffix).Value(summary.p90)
+            .Key("p99"s + suffix).Value(summary.p99)
+            .Key("max"s + suffix).Value(summary.max)
+            .EndDict();
+    }
+
+}  // namespace bench
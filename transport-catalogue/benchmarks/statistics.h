@@ -0,0 +1,28 @@
+#pragma once
+
+#include "json_writer.h"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+
+    // Distribution of a set of timings, in whatever unit they were taken
+    struct Summary {
+        size_t count = 0;
+        double mean = 0;
+        double min = 0;
+        double p50 = 0;
+        double p90 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    // Percentiles by nearest rank
+    Summary Summarize(std::vector<double> samples);
+
+    // Writes the summary as a dict, with the unit in the keys: "mean_us" and so on
+    void WriteSummary(json::Writer& writer, const Summary& summary, std::string_view unit = "us");
+
+}  // namespace bench
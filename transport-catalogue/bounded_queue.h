@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace concurrency {
+
+    // Multi-producer multi-consumer FIFO holding at most capacity items:
+    // Push blocks while the queue is full, Pop blocks while it is empty.
+    // After Close() pushes are dropped and Pop drains what is left, then returns nullopt
+    template <typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity)
+            : capacity_(capacity == 0 ? 1 : capacity) {
+        }
+
+        // Returns false if the queue was closed and the item was not taken
+        bool Push(T item) {
+            std::unique_lock lock(mutex_);
+            not_full_.wait(lock, [this] {
+                return closed_ || items_.size() < capacity_;
+            });
+            if (closed_) {
+                return false;
+            }
+            items_.push_back(std::move(item));
+            not_empty_.notify_one();
+            return true;
+        }
+
+        std::optional<T> Pop() {
+            std::unique_lock lock(mutex_);
+            not_empty_.wait(lock, [this] {
+                return closed_ || !items_.empty();
+            });
+            if (items_.empty()) {
+                return std::nullopt;
+            }
+            std::optional<T> item(std::move(items_.front()));
+            items_.pop_front();
+            not_full_.notify_one();
+            return item;
+        }
+
+        void Close() {
+            {
+                std::lock_guard lock(mutex_);
+                closed_ = true;
+            }
+            not_full_.notify_all();
+            not_empty_.notify_all();
+        }
+
+    private:
+        const size_t capacity_;
+        std::mutex mutex_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+        std::deque<T> items_;
+        bool closed_ = false;
+    };
+
+} // namespace concurrency
@@ -0,0 +1,106 @@
+#include "catalogue_view.h"
+#include "transport_catalogue.h"
+
+#include <algorithm>
+
+namespace transport_catalogue {
+
+	namespace {
+		BusStats ComputeBusStats(const Bus& bus, const TransportCatalogue& catalogue) {
+			BusStats result;
+			if (bus.stops.empty()) {
+				return result;
+			}
+			result.stop_count = bus.is_roundtrip ? bus.stops.size() : bus.stops.size() * 2 - 1;
+			result.unique_stop_count = catalogue.CountUniqueStops(bus);
+
+			double geo_distance = catalogue.ComputeGeoLength(bus.stops);
+			int real_distance = 0;
+			for (size_t i = 0; i + 1 < bus.stops.size(); ++i) {
+				real_distance += catalogue.GetDistance(bus.stops[i], bus.stops[i + 1]);
+			}
+			if (!bus.is_roundtrip) {
+				for (size_t i = 0; i + 1 < bus.stops.size(); ++i) {
+					real_distance += catalogue.GetDistance(bus.stops[i + 1], bus.stops[i]);
+				}
+				geo_distance *= 2;
+			}
+			result.route_length = real_distance;
+			result.curvature = real_distance / geo_distance;
+			return result;
+		}
+	}
+
+	CatalogueView::CatalogueView(const TransportCatalogue& catalogue)
+		: graph_(catalogue.GetGraphConstRef())
+		, bus_waiting_time_(catalogue.GetBusWaitingTime())
+		, render_settings_(catalogue.GetRenderSettings()) {
+		const auto by_name = [](const NameIndex& lhs, const NameIndex& rhs) {
+			return lhs.name < rhs.name;
+		};
+		const auto same_name = [](const NameIndex& lhs, const NameIndex& rhs) {
+			return lhs.name == rhs.name;
+		};
+
+		for (const Stop& stop : catalogue.GetStops()) {
+			stops_.push_back(&stop);
+			stop_names_.push_back({ stop.name, static_cast<uint32_t>(stop.id) });
+		}
+		// Stable, so that of two stops with one name the first added is found, as before
+		std::stable_sort(stop_names_.begin(), stop_names_.end(), by_name);
+		stop_names_.erase(std::unique(stop_names_.begin(), stop_names_.end(), same_name), stop_names_.end());
+
+		for (const Bus& bus : catalogue.GetBuses()) {
+			buses_.push_back(&bus);
+			bus_names_.push_back({ bus.name, static_cast<uint32_t>(bus.id) });
+			bus_stats_.push_back(ComputeBusStats(bus, catalogue));
+		}
+		std::stable_sort(bus_names_.begin(), bus_names_.end(), by_name);
+
+		// Buses are visited by name, so every stop's list comes out sorted; a bus that passes
+		// a stop several times adds it once, thanks to the last-added check
+		std::vector<std::vector<std::string_view>> buses_by_stop(stops_.size());
+		for (const NameIndex& bus_name : bus_names_) {
+			for (const Stop* stop : buses_[bus_name.id]->stops) {
+				std::vector<std::string_view>& names = buses_by_stop[stop->id];
+				if (names.empty() || names.back() != bus_name.name) {
+					names.push_back(bus_name.name);
+				}
+			}
+		}
+
+		bus_names_.erase(std::unique(bus_names_.begin(), bus_names_.end(), same_name), bus_names_.end());
+		for (const NameIndex& bus_name : bus_names_) {
+			buses_by_name_.push_back(buses_[bus_name.id]);
+		}
+
+		stop_bus_begin_.reserve(stops_.size() + 1);
+		stop_bus_begin_.push_back(0);
+		for (const std::vector<std::string_view>& names : buses_by_stop) {
+			stop_bus_names_.insert(stop_bus_names_.end(), names.begin(), names.end());
+			stop_bus_begin_.push_back(static_cast<uint32_t>(stop_bus_names_.size()));
+		}
+	}
+
+	const CatalogueView::NameIndex* CatalogueView::Find(const std::vector<NameIndex>& index, std::string_view name) {
+		const auto it = std::lower_bound(index.begin(), index.end(), name,
+			[](const NameIndex& entry, std::string_view value) {
+				return entry.name < value;
+			});
+		if (it == index.end() || it->name != name) {
+			return nullptr;
+		}
+		return &*it;
+	}
+
+	const Stop* CatalogueView::FindStop(std::string_view name) const {
+		const NameIndex* entry = Find(stop_names_, name);
+		return entry ? stops_[entry->id] : nullptr;
+	}
+
+	const Bus* CatalogueView::FindBus(std::string_view name) const {
+		const NameIndex* entry = Find(bus_names_, name);
+		return entry ? buses_[entry->id] : nullptr;
+	}
+
+} // namespace transport_catalogue
@@ -0,0 +1,92 @@
+#pragma once
+#include "domain.h"
+#include "graph.h"
+#include "map_renderer.h"
+#include "ranges.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace transport_catalogue {
+
+	class TransportCatalogue;
+
+	// The answer to a Bus request
+	struct BusStats {
+		int stop_count = 0;
+		int unique_stop_count = 0;
+		int route_length = 0;
+		double curvature = 0;
+	};
+
+	// Read-only form of a filled catalogue, made once by TransportCatalogue::Freeze.
+	// Everything is laid out in flat arrays indexed by Stop::id and Bus::id, names are
+	// looked up by binary search over sorted arrays, and the answer to every Bus request
+	// is computed up front. Nothing in it changes after construction, so its queries take
+	// no locks, share no scratch state and may be called from any number of threads.
+	// It points into the catalogue, which outlives it and no longer changes once frozen
+	class CatalogueView {
+	public:
+		using Graph = graph::DirectedWeightedGraph<double>;
+		using BusNames = ranges::Range<const std::string_view*>;
+
+		explicit CatalogueView(const TransportCatalogue& catalogue);
+		CatalogueView(const CatalogueView&) = delete;
+		CatalogueView& operator=(const CatalogueView&) = delete;
+
+		// nullptr if there is no such stop or bus
+		const Stop* FindStop(std::string_view name) const;
+		const Bus* FindBus(std::string_view name) const;
+
+		// Also the stop with vertex id in the routing graph
+		const Stop& GetStop(size_t id) const {
+			return *stops_[id];
+		}
+		// Names of the buses through the stop, sorted and without repeats
+		BusNames GetBusesByStop(const Stop& stop) const {
+			const std::string_view* names = stop_bus_names_.data();
+			return { names + stop_bus_begin_[stop.id], names + stop_bus_begin_[stop.id + 1] };
+		}
+		const BusStats& GetBusStats(const Bus& bus) const {
+			return bus_stats_[bus.id];
+		}
+		// Every bus, sorted by name
+		const std::vector<const Bus*>& GetBusesByName() const {
+			return buses_by_name_;
+		}
+
+		const Graph& GetGraph() const {
+			return graph_;
+		}
+		int GetBusWaitingTime() const {
+			return bus_waiting_time_;
+		}
+		const map_renderer::detail::RenderSettings& GetRenderSettings() const {
+			return render_settings_;
+		}
+
+	private:
+		struct NameIndex {
+			std::string_view name;
+			uint32_t id;
+		};
+
+		static const NameIndex* Find(const std::vector<NameIndex>& index, std::string_view name);
+
+		std::vector<const Stop*> stops_;
+		std::vector<const Bus*> buses_;
+		// Sorted by name
+		std::vector<NameIndex> stop_names_;
+		std::vector<NameIndex> bus_names_;
+		std::vector<const Bus*> buses_by_name_;
+		// Buses of stop s are stop_bus_names_[stop_bus_begin_[s], stop_bus_begin_[s + 1])
+		std::vector<uint32_t> stop_bus_begin_;
+		std::vector<std::string_view> stop_bus_names_;
+		std::vector<BusStats> bus_stats_;
+		const Graph& graph_;
+		int bus_waiting_time_;
+		const map_renderer::detail::RenderSettings& render_settings_;
+	};
+
+} // namespace transport_catalogue
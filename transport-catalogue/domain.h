@@ -7,6 +7,8 @@ namespace transport_catalogue {
 	struct Stop {
 		std::string name;
 		geo::Coordinates coords;
+		// Position in the catalogue, also the stop's vertex id in the routing graph
+		size_t id = 0;
 
 		bool operator==(const Stop& other) {
 			return name == other.name && coords == other.coords;
@@ -21,6 +23,8 @@ namespace transport_catalogue {
 		std::string name;
 		std::vector<const Stop*> stops;
 		bool is_roundtrip;
+		// Position in the catalogue
+		size_t id = 0;
 	};
 
 	struct BusData {
@@ -36,4 +40,12 @@ namespace transport_catalogue {
 		int bus_wait_time;
 		int bus_velocity;
 	};
+
+	struct SerializationSettings {
+		std::string file;
+		// Render the map at make_base and store it in the base
+		bool prerender_map = false;
+		// If set, make_base also writes the router's table there, for serve to map
+		std::string router_table;
+	};
 }
\ No newline at end of file
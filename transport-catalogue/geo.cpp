@@ -5,15 +5,90 @@
 
 namespace geo {
 
+    namespace {
+        const double DR = M_PI / 180.;
+        const double EARTH_RADIUS = 6371000;
+    }
+
     double ComputeDistance(Coordinates from, Coordinates to) {
         using namespace std;
         if (from == to) {
             return 0;
         }
-        static const double dr = M_PI / 180.;
-        return acos(sin(from.lat * dr) * sin(to.lat * dr)
-            + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
-            * 6371000;
+        return acos(sin(from.lat * DR) * sin(to.lat * DR)
+            + cos(from.lat * DR) * cos(to.lat * DR) * cos(abs(from.lng - to.lng) * DR))
+            * EARTH_RADIUS;
+    }
+
+    void PointArrays::Clear() {
+        lat_.clear();
+        lng_.clear();
+        sin_lat_.clear();
+        cos_lat_.clear();
+    }
+
+    void PointArrays::Reserve(size_t count) {
+        lat_.reserve(count);
+        lng_.reserve(count);
+        sin_lat_.reserve(count);
+        cos_lat_.reserve(count);
+    }
+
+    size_t PointArrays::Add(Coordinates point) {
+        lat_.push_back(point.lat);
+        lng_.push_back(point.lng);
+        sin_lat_.push_back(std::sin(point.lat * DR));
+        cos_lat_.push_back(std::cos(point.lat * DR));
+        return lat_.size() - 1;
+    }
+
+    double PointArrays::ComputeDistance(size_t from, size_t to) const {
+        // Equal points: the cosine may round to just above 1 and acos give NaN
+        if (lat_[from] == lat_[to] && lng_[from] == lng_[to]) {
+            return 0;
+        }
+        return std::acos(sin_lat_[from] * sin_lat_[to]
+            + cos_lat_[from] * cos_lat_[to] * std::cos(std::abs(lng_[from] - lng_[to]) * DR))
+            * EARTH_RADIUS;
+    }
+
+    void PointArrays::ComputeSegmentDistances(const size_t* path, size_t count, double* distances) const {
+        const size_t segment_count = count < 2 ? 0 : count - 1;
+        const double* lat = lat_.data();
+        const double* lng = lng_.data();
+        const double* sin_lat = sin_lat_.data();
+        const double* cos_lat = cos_lat_.data();
+
+        // Pass by pass, so the arithmetic passes have no calls or branches in them
+        for (size_t i = 0; i < segment_count; ++i) {
+            distances[i] = std::abs(lng[path[i]] - lng[path[i + 1]]) * DR;
+        }
+        for (size_t i = 0; i < segment_count; ++i) {
+            distances[i] = std::cos(distances[i]);
+        }
+        for (size_t i = 0; i < segment_count; ++i) {
+            distances[i] = sin_lat[path[i]] * sin_lat[path[i + 1]]
+                + cos_lat[path[i]] * cos_lat[path[i + 1]] * distances[i];
+        }
+        for (size_t i = 0; i < segment_count; ++i) {
+            distances[i] = std::acos(distances[i]) * EARTH_RADIUS;
+        }
+        for (size_t i = 0; i < segment_count; ++i) {
+            if (lat[path[i]] == lat[path[i + 1]] && lng[path[i]] == lng[path[i + 1]]) {
+                distances[i] = 0;
+            }
+        }
+    }
+
+    double PointArrays::ComputeLength(const size_t* path, size_t count) const {
+        static thread_local std::vector<double> distances;
+        distances.resize(count);
+        ComputeSegmentDistances(path, count, distances.data());
+        double result = 0;
+        for (size_t i = 0; i + 1 < count; ++i) {
+            result += distances[i];
+        }
+        return result;
     }
 
 }  // namespace geo
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 namespace geo {
 
     struct Coordinates {
@@ -15,4 +18,34 @@ namespace geo {
 
     double ComputeDistance(Coordinates from, Coordinates to);
 
+    // Points as separate arrays, with the sines and cosines of the latitudes computed once,
+    // when a point is added. A distance between stored points then costs one cos and one acos.
+    // Every distance is exactly ComputeDistance of the two points: the same operations in
+    // the same order, only with the latitude terms looked up
+    class PointArrays {
+    public:
+        void Clear();
+        void Reserve(size_t count);
+        // Returns the index of the point
+        size_t Add(Coordinates point);
+
+        size_t Size() const {
+            return lat_.size();
+        }
+
+        double ComputeDistance(size_t from, size_t to) const;
+        // Distance along a path through the points path[0], path[1], ... for each of its
+        // count - 1 segments, into distances; computed as plain loops over contiguous doubles
+        void ComputeSegmentDistances(const size_t* path, size_t count, double* distances) const;
+        // Sum of the segment distances, added up from the first segment on like a loop
+        // over ComputeDistance would
+        double ComputeLength(const size_t* path, size_t count) const;
+
+    private:
+        std::vector<double> lat_;
+        std::vector<double> lng_;
+        std::vector<double> sin_lat_;
+        std::vector<double> cos_lat_;
+    };
+
 }  // namespace geo
\ No newline at end of file
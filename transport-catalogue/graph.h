@@ -3,6 +3,8 @@
 #include "ranges.h"
 
 #include <cstdlib>
+#include <string>
+#include <utility>
 #include <vector>
 #include <string_view>
 
@@ -29,7 +31,7 @@ namespace graph {
     public:
         DirectedWeightedGraph() = default;
         explicit DirectedWeightedGraph(size_t vertex_count);
-        EdgeId AddEdge(const Edge<Weight>& edge);
+        EdgeId AddEdge(Edge<Weight> edge);
 
         size_t GetVertexCount() const;
         size_t GetEdgeCount() const;
@@ -54,10 +56,11 @@ namespace graph {
     }
 
     template <typename Weight>
-    EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
-        edges_.push_back(edge);
+    EdgeId DirectedWeightedGraph<Weight>::AddEdge(Edge<Weight> edge) {
+        const VertexId from = edge.from;
+        edges_.push_back(std::move(edge));
         const EdgeId id = edges_.size() - 1;
-        incidence_lists_.at(edge.from).push_back(id);
+        incidence_lists_.at(from).push_back(id);
         return id;
     }
 
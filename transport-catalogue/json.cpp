@@ -1,4 +1,12 @@
 #include "json.h"
+#include "json_scanner.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <iterator>
+#include <optional>
+#include <tuple>
 
 using namespace std;
 
@@ -6,119 +14,262 @@ namespace json {
 
     namespace {
 
-        Node LoadNode(istream& input);
+        constexpr size_t ARENA_INITIAL_SIZE = 64 * 1024;
+
+        bool IsSpace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+        }
+
+        // Recursive descent over the whole input held in memory: string bodies are
+        // copied run by run between the bytes found by detail::FindStringSpecial
+        class Parser {
+        public:
+            Parser(string_view text, pmr::memory_resource* arena)
+                : pos_(text.data())
+                , end_(text.data() + text.size())
+                , arena_(arena) {
+            }
+
+            Node LoadNode();
+
+            // Helpers for reading a document piece by piece
+            void SkipValue();
+            void Expect(char c);
+            int Peek();
+            const char* Position() const {
+                return pos_;
+            }
+            // Starts over on another text, keeping the scratch buffers
+            void Reset(string_view text) {
+                pos_ = text.data();
+                end_ = text.data() + text.size();
+            }
+            void LoadStringInto(string& s);
+            // Returns the next element of an array whose '[' was consumed, nullopt after ']'
+            optional<Node> LoadNextElement();
+
+        private:
+            Node LoadArray();
+            Node LoadNumber();
+            Node LoadString();
+            Node LoadDict();
+            Node LoadLiteral();
+            void SkipString();
+
+            static bool IsDigit(const char* pos, const char* end) {
+                return pos != end && *pos >= '0' && *pos <= '9';
+            }
+
+            const char* pos_;
+            const char* end_;
+            pmr::memory_resource* arena_;
+            // Elements of unfinished arrays and dicts are collected here and moved
+            // into exactly sized arena blocks once the closing bracket is met
+            vector<Node> array_scratch_;
+            vector<pair<string, Node>> dict_scratch_;
+        };
+
+        // Skips whitespace and returns the next character without consuming it, or EOF
+        int Parser::Peek() {
+            while (pos_ != end_ && IsSpace(*pos_)) {
+                ++pos_;
+            }
+            return pos_ != end_ ? static_cast<unsigned char>(*pos_) : EOF;
+        }
+
+        void Parser::Expect(char c) {
+            if (Peek() != static_cast<unsigned char>(c)) {
+                throw ParsingError("Expected '"s + c + "'"s);
+            }
+            ++pos_;
+        }
+
+        void Parser::SkipString() {
+            while (true) {
+                pos_ = detail::FindStringSpecial(pos_, end_);
+                if (pos_ == end_) {
+                    throw ParsingError("String parsing error"s);
+                }
+                const char ch = *pos_++;
+                if (ch == '"') {
+                    return;
+                }
+                if (ch == '\\') {
+                    if (pos_ == end_) {
+                        throw ParsingError("String parsing error"s);
+                    }
+                    ++pos_;
+                }
+            }
+        }
+
+        // Walks over a value without building it; only brackets and strings are looked at
+        void Parser::SkipValue() {
+            const int c = Peek();
+            if (c == EOF) {
+                throw ParsingError("End of file");
+            }
+            ++pos_;
+            if (c == '"') {
+                SkipString();
+            }
+            else if (c == '[') {
+                for (int next; (next = Peek()) != ']';) {
+                    if (next == EOF) {
+                        throw ParsingError("Array parsing error");
+                    }
+                    if (next == ',') {
+                        ++pos_;
+                        continue;
+                    }
+                    SkipValue();
+                }
+                ++pos_;
+            }
+            else if (c == '{') {
+                for (int next; (next = Peek()) != '}';) {
+                    if (next == EOF) {
+                        throw ParsingError("Dict parsing error"s);
+                    }
+                    if (next == ',') {
+                        ++pos_;
+                        continue;
+                    }
+                    Expect('"');
+                    SkipString();
+                    Expect(':');
+                    SkipValue();
+                }
+                ++pos_;
+            }
+            else {
+                while (pos_ != end_ && *pos_ != ',' && *pos_ != ']' && *pos_ != '}' && !IsSpace(*pos_)) {
+                    ++pos_;
+                }
+            }
+        }
+
+        optional<Node> Parser::LoadNextElement() {
+            int c = Peek();
+            if (c == ']') {
+                ++pos_;
+                return nullopt;
+            }
+            if (c == ',') {
+                ++pos_;
+                c = Peek();
+            }
+            if (c == EOF) {
+                throw ParsingError("Array parsing error");
+            }
+            return LoadNode();
+        }
 
-        Node LoadArray(istream& input) {
-            Array result;
+        Node Parser::LoadArray() {
+            const size_t first = array_scratch_.size();
             bool met_the_end = false;
 
-            for (char c; input >> c;) {
+            for (int c; (c = Peek()) != EOF;) {
                 if (c == ']') {
+                    ++pos_;
                     met_the_end = true;
                     break;
                 }
-                if (c != ',') {
-                    input.putback(c);
+                if (c == ',') {
+                    ++pos_;
                 }
-                result.push_back(LoadNode(input));
+                Node element = LoadNode();
+                array_scratch_.push_back(move(element));
             }
 
             if (!met_the_end) {
                 throw ParsingError("Array parsing error");
             }
 
+            Array result(arena_);
+            result.reserve(array_scratch_.size() - first);
+            move(array_scratch_.begin() + first, array_scratch_.end(), back_inserter(result));
+            array_scratch_.resize(first);
             return Node(move(result));
         }
 
-        using Number = std::variant<int, double>;
-        Node LoadNumber(istream& input) {
+        Node Parser::LoadNumber() {
             using namespace std::literals;
 
-            std::string parsed_num;
+            const char* const first = pos_;
+            const char* pos = pos_;
 
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Failed to read number from stream"s);
-                }
-            };
-
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
+            auto read_digits = [&pos, this] {
+                if (!IsDigit(pos, end_)) {
                     throw ParsingError("A digit was expected");
                 }
-                while (std::isdigit(input.peek())) {
-                    read_char();
+                while (IsDigit(pos, end_)) {
+                    ++pos;
                 }
             };
 
-            if (input.peek() == '-') {
-                read_char();
+            if (pos != end_ && *pos == '-') {
+                ++pos;
             }
 
-            if (input.peek() == '0') {
-                read_char();
+            if (pos != end_ && *pos == '0') {
+                ++pos;
             }
             else {
                 read_digits();
             }
 
             bool is_int = true;
-            if (input.peek() == '.') {
-                read_char();
+            if (pos != end_ && *pos == '.') {
+                ++pos;
                 read_digits();
                 is_int = false;
             }
 
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
+            if (pos != end_ && (*pos == 'e' || *pos == 'E')) {
+                ++pos;
+                if (pos != end_ && (*pos == '+' || *pos == '-')) {
+                    ++pos;
                 }
                 read_digits();
                 is_int = false;
             }
 
-            try {
-                if (is_int) {
-                    try {
-                        return Node(std::stoi(parsed_num));
-                    }
-                    catch (...) {
-
-                    }
+            pos_ = pos;
+            if (is_int) {
+                int value;
+                if (auto [ptr, ec] = from_chars(first, pos, value); ec == errc() && ptr == pos) {
+                    return Node(value);
                 }
-                return Node(std::stod(parsed_num));
+                // Out of int range: fall back to double as before
             }
-            catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+            double value;
+            if (auto [ptr, ec] = from_chars(first, pos, value); ec == errc() && ptr == pos) {
+                return Node(value);
             }
-
+            throw ParsingError("Failed to convert "s + string(first, pos) + " to number"s);
         }
 
-        Node LoadString(istream& input) {
+        void Parser::LoadStringInto(string& s) {
             using namespace std::literals;
 
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-
-            std::string s;
             while (true) {
-                if (it == end) {
+                const char* special = detail::FindStringSpecial(pos_, end_);
+                s.append(pos_, special);
+                pos_ = special;
+                if (pos_ == end_) {
                     throw ParsingError("String parsing error"s);
                 }
-                const char ch = *it;
+                const char ch = *pos_++;
                 if (ch == '"') {
-                    ++it;
                     break;
                 }
                 else if (ch == '\\') {
-                    ++it;
-                    if (it == end) {
+                    if (pos_ == end_) {
                         throw ParsingError("String parsing error"s);
                     }
-                    const char escaped_char = *it;
-                    //    : \\, \n, \t, \r, \"
+                    const char escaped_char = *pos_++;
+                    // Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
                     switch (escaped_char) {
                     case 'n':
                         s.push_back('\n');
@@ -140,112 +291,119 @@ namespace json {
                     }
                 }
                 else if (ch == '\n' || ch == '\r') {
-                    //    JSON     \r  \n
+                    // Строковый литерал внутри JSON не может прерываться символами \r или \n
                     throw ParsingError("Unexpected end of line"s);
                 }
                 else {
+                    // Other control characters are kept as is
                     s.push_back(ch);
                 }
-                ++it;
             }
+        }
 
-            return Node(s);
+        Node Parser::LoadString() {
+            std::string s;
+            LoadStringInto(s);
+            return Node(move(s));
         }
 
-        Node LoadDict(istream& input) {
-            Dict result;
+        Node Parser::LoadDict() {
+            const size_t first = dict_scratch_.size();
             bool met_the_end = false;
 
-            for (char c; input >> c;) {
+            for (int c; (c = Peek()) != EOF;) {
                 if (c == '}') {
+                    ++pos_;
                     met_the_end = true;
                     break;
                 }
                 if (c == ',') {
-                    input >> c;
+                    ++pos_;
+                    Peek();
+                }
+                if (pos_ == end_ || *pos_ != '"') {
+                    throw ParsingError("Dict key expected"s);
                 }
+                ++pos_;
 
-                string key = LoadString(input).AsString();
-                input >> c;
-                result.insert({ move(key), LoadNode(input) });
+                string key;
+                LoadStringInto(key);
+                if (Peek() != ':') {
+                    throw ParsingError("Colon expected after a dict key"s);
+                }
+                ++pos_;
+                Node value = LoadNode();
+                dict_scratch_.emplace_back(move(key), move(value));
             }
             if (!met_the_end) {
                 throw ParsingError("Dict parsing error"s);
             }
+
+            // Keep the first of duplicate keys, as std::map::insert used to
+            auto entries_begin = dict_scratch_.begin() + first;
+            stable_sort(entries_begin, dict_scratch_.end(),
+                [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+            Dict result(arena_);
+            result.reserve(dict_scratch_.size() - first);
+            for (auto it = entries_begin; it != dict_scratch_.end(); ++it) {
+                result.emplace(it->first, move(it->second));
+            }
+            dict_scratch_.resize(first);
             return Node(move(result));
         }
 
-        Node LoadBool(istream& input) {
-            string s;
-            for (char c; input >> c;) {
-                if (c == EOF || c == ',' || c == ']' || c == '}') {
-                    input.putback(c);
-                    break;
-                }
-                s += c;
+        Node Parser::LoadLiteral() {
+            const char* word_end = pos_;
+            while (word_end != end_ && *word_end >= 'a' && *word_end <= 'z') {
+                ++word_end;
             }
+            const string_view word(pos_, word_end - pos_);
+            pos_ = word_end;
 
-            if (s == "true"s) {
+            if (word == "true"sv) {
                 return Node(true);
             }
-            else if (s == "false"s) {
+            else if (word == "false"sv) {
                 return Node(false);
             }
-            else {
-                throw ParsingError("Couldn't parse bool value"s);
-            }
-        }
-
-        Node LoadNull(istream& input) {
-            string s;
-            for (char c; input >> c;) {
-                if (c == EOF || c == ',' || c == ']' || c == '}') {
-                    input.putback(c);
-                    break;
-                }
-                s += c;
-            }
-
-            if (s == "null"s) {
+            else if (word == "null"sv) {
                 return Node(nullptr);
             }
-            else {
+            else if (word.front() == 'n') {
                 throw ParsingError("Couldn't parse null value");
             }
+            else {
+                throw ParsingError("Couldn't parse bool value"s);
+            }
         }
 
-        Node LoadNode(istream& input) {
-            char c;
-            input >> c;
+        Node Parser::LoadNode() {
+            const int c = Peek();
 
             switch (c) {
             case EOF:
                 throw ParsingError("End of file");
                 break;
             case '[':
-                return LoadArray(input);
+                ++pos_;
+                return LoadArray();
                 break;
             case '{':
-                return LoadDict(input);
+                ++pos_;
+                return LoadDict();
                 break;
             case '"':
-                return LoadString(input);
+                ++pos_;
+                return LoadString();
                 break;
             case ('t'):
-                input.putback(c);
-                return LoadBool(input);
-                break;
             case ('f'):
-                input.putback(c);
-                return LoadBool(input);
-                break;
             case ('n'):
-                input.putback(c);
-                return LoadNull(input);
+                return LoadLiteral();
                 break;
             default:
-                input.putback(c);
-                return LoadNumber(input);
+                return LoadNumber();
             }
         }
     } // anonymous namespace
@@ -297,15 +455,13 @@ namespace json {
     }
 
     double Node::AsDouble() const {
-        if (!IsDouble()) {
-            throw logic_error("logic error");
-        }
-        try {
-            return get<double>(*this);
+        if (const double* value = get_if<double>(&GetNodeData())) {
+            return *value;
         }
-        catch (...) {
-            return get<int>(*this);
+        if (const int* value = get_if<int>(&GetNodeData())) {
+            return *value;
         }
+        throw logic_error("logic error");
     }
 
     string& Node::AsString() {
@@ -350,10 +506,102 @@ namespace json {
         return get<Dict>(*this);
     }
 
+    Dict::Dict(const allocator_type& alloc)
+        : entries_(alloc) {
+    }
+
+    Dict::Dict(std::initializer_list<std::pair<std::string_view, Node>> entries) {
+        entries_.reserve(entries.size());
+        for (const auto& [key, value] : entries) {
+            emplace(key, value);
+        }
+    }
+
+    Dict::iterator Dict::LowerBound(std::string_view key) {
+        return lower_bound(entries_.begin(), entries_.end(), key,
+            [](const value_type& entry, std::string_view key) { return entry.first < key; });
+    }
+
+    Dict::const_iterator Dict::LowerBound(std::string_view key) const {
+        return lower_bound(entries_.begin(), entries_.end(), key,
+            [](const value_type& entry, std::string_view key) { return entry.first < key; });
+    }
+
+    Node& Dict::at(std::string_view key) {
+        if (auto it = find(key); it != entries_.end()) {
+            return it->second;
+        }
+        throw out_of_range("Dict::at: no such key");
+    }
+
+    const Node& Dict::at(std::string_view key) const {
+        if (auto it = find(key); it != entries_.end()) {
+            return it->second;
+        }
+        throw out_of_range("Dict::at: no such key");
+    }
+
+    Node& Dict::operator[](std::string_view key) {
+        return emplace(key, nullptr).first->second;
+    }
+
+    Dict::iterator Dict::find(std::string_view key) {
+        auto it = LowerBound(key);
+        return it != entries_.end() && it->first == key ? it : entries_.end();
+    }
+
+    Dict::const_iterator Dict::find(std::string_view key) const {
+        auto it = LowerBound(key);
+        return it != entries_.end() && it->first == key ? it : entries_.end();
+    }
+
+    size_t Dict::count(std::string_view key) const {
+        return find(key) != entries_.end() ? 1 : 0;
+    }
+
+    std::pair<Dict::iterator, bool> Dict::insert(std::pair<std::string_view, Node> entry) {
+        return emplace(entry.first, move(entry.second));
+    }
+
+    std::pair<Dict::iterator, bool> Dict::emplace(std::string_view key, Node value) {
+        // Appending in key order is the common case: parsed dicts arrive presorted
+        if (entries_.empty() || entries_.back().first < key) {
+            entries_.emplace_back(piecewise_construct, forward_as_tuple(key), forward_as_tuple(move(value)));
+            return { prev(entries_.end()), true };
+        }
+        auto it = LowerBound(key);
+        if (it->first == key) {
+            return { it, false };
+        }
+        it = entries_.emplace(it, piecewise_construct, forward_as_tuple(key), forward_as_tuple(move(value)));
+        return { it, true };
+    }
+
+    bool Dict::operator==(const Dict& other) const {
+        return entries_.size() == other.entries_.size()
+            && equal(entries_.begin(), entries_.end(), other.entries_.begin());
+    }
+
     Document::Document(Node root)
         : root_(move(root)) {
     }
 
+    Document::Document(Node root, std::unique_ptr<std::pmr::memory_resource> arena)
+        : arena_(move(arena))
+        , root_(move(root)) {
+    }
+
+    Document& Document::operator=(Document&& other) noexcept {
+        if (this != &other) {
+            // Release the old tree while its arena is still alive, then adopt the new
+            // pair; assigning a different alternative move-constructs, keeping the allocator
+            root_ = nullptr;
+            arena_ = move(other.arena_);
+            root_ = move(other.root_);
+        }
+        return *this;
+    }
+
     const Node& Document::GetRoot() const {
         return root_;
     }
@@ -365,27 +613,11 @@ namespace json {
         ctx.out << value;
     }
 
-    void PrintString(const std::string& value, std::ostream& out) {
+    void PrintString(std::string_view value, std::ostream& out) {
         out.put('"');
-        for (const char c : value) {
-            switch (c) {
-            case '\r':
-                out << "\\r"sv;
-                break;
-            case '\n':
-                out << "\\n"sv;
-                break;
-            case '"':
-                //  "  \   \"  \\, 
-                [[fallthrough]];
-            case '\\':
-                out.put('\\');
-                [[fallthrough]];
-            default:
-                out.put(c);
-                break;
-            }
-        }
+        detail::WriteEscaped(value, [&out](std::string_view part) {
+            out.write(part.data(), part.size());
+        });
         out.put('"');
     }
 
@@ -399,9 +631,9 @@ namespace json {
         ctx.out << "null"sv;
     }
 
-    //    PrintValue   bool  value 
-    //   ,     .
-    //      :
+    // В специализаци шаблона PrintValue для типа bool параметр value передаётся
+    // по константной ссылке, как и в основном шаблоне.
+    // В качестве альтернативы можно использовать перегрузку:
     // void PrintValue(bool value, const PrintContext& ctx);
     template <>
     void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
@@ -461,7 +693,230 @@ namespace json {
     }
 
     Document Load(std::istream& input) {
-        return Document{ LoadNode(input) };
+        // The whole input is read in one go and scanned in memory
+        const std::string text(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>{});
+        return Load(std::string_view(text));
+    }
+
+    std::vector<std::pair<std::string, std::string_view>> SplitObject(std::string_view text) {
+        std::vector<std::pair<std::string, std::string_view>> result;
+        Parser parser(text, pmr::get_default_resource());
+        parser.Expect('{');
+        for (int c; (c = parser.Peek()) != '}';) {
+            if (c == ',') {
+                parser.Expect(',');
+                continue;
+            }
+            parser.Expect('"');
+            std::string key;
+            parser.LoadStringInto(key);
+            parser.Expect(':');
+            parser.Peek();
+            const char* value_begin = parser.Position();
+            parser.SkipValue();
+            result.emplace_back(move(key), std::string_view(value_begin, parser.Position() - value_begin));
+        }
+        return result;
+    }
+
+    StreamReader::StreamReader(std::istream& input, size_t chunk_size)
+        : input_(input)
+        , chunk_size_(std::max<size_t>(chunk_size, 1)) {
+    }
+
+    bool StreamReader::Fill() {
+        chunk_.resize(chunk_size_);
+        input_.read(chunk_.data(), static_cast<streamsize>(chunk_size_));
+        chunk_.resize(static_cast<size_t>(input_.gcount()));
+        pos_ = 0;
+        return !chunk_.empty();
+    }
+
+    int StreamReader::Peek() {
+        while (true) {
+            if (pos_ == chunk_.size() && !Fill()) {
+                return EOF;
+            }
+            if (!IsSpace(chunk_[pos_])) {
+                return static_cast<unsigned char>(chunk_[pos_]);
+            }
+            ++pos_;
+        }
+    }
+
+    void StreamReader::Expect(char c) {
+        if (Peek() != static_cast<unsigned char>(c)) {
+            throw ParsingError("Expected '"s + c + "'"s);
+        }
+        ++pos_;
+    }
+
+    std::optional<std::string> StreamReader::NextKey() {
+        int c = Peek();
+        if (c == '}') {
+            ++pos_;
+            return std::nullopt;
+        }
+        if (c == ',') {
+            ++pos_;
+            c = Peek();
+        }
+        if (c != '"') {
+            throw ParsingError("Dict key expected"s);
+        }
+        std::string text;
+        ReadValue(&text);
+        Parser parser(text, pmr::get_default_resource());
+        parser.Expect('"');
+        std::string key;
+        parser.LoadStringInto(key);
+        Expect(':');
+        return key;
+    }
+
+    void StreamReader::ReadValueText(std::string& text) {
+        text.clear();
+        ReadValue(&text);
+    }
+
+    void StreamReader::SkipValue() {
+        ReadValue(nullptr);
+    }
+
+    // Finds where the value ends by its brackets and strings alone; the text is checked
+    // when it is parsed. Runs of plain text are copied from the chunk in one go
+    void StreamReader::ReadValue(std::string* text) {
+        if (Peek() == EOF) {
+            throw ParsingError("End of file");
+        }
+        size_t begin = pos_;
+        auto take = [&] {
+            if (text) {
+                text->append(chunk_, begin, pos_ - begin);
+            }
+        };
+        int depth = 0;
+        bool in_string = false;
+        bool escaped = false;
+        while (true) {
+            if (pos_ == chunk_.size()) {
+                take();
+                if (!Fill()) {
+                    // Only a number or a literal may end with the input
+                    if (depth > 0 || in_string) {
+                        throw ParsingError("End of file");
+                    }
+                    return;
+                }
+                begin = 0;
+            }
+            const char c = chunk_[pos_];
+            if (in_string) {
+                if (escaped) {
+                    escaped = false;
+                }
+                else if (c == '\\') {
+                    escaped = true;
+                }
+                else if (c == '"') {
+                    in_string = false;
+                    if (depth == 0) {
+                        ++pos_;
+                        break;
+                    }
+                }
+            }
+            else if (c == '"') {
+                in_string = true;
+            }
+            else if (c == '[' || c == '{') {
+                ++depth;
+            }
+            else if (c == ']' || c == '}') {
+                if (depth == 0) {
+                    break;
+                }
+                if (--depth == 0) {
+                    ++pos_;
+                    break;
+                }
+            }
+            else if (depth == 0 && (c == ',' || IsSpace(c))) {
+                break;
+            }
+            ++pos_;
+        }
+        take();
+    }
+
+    class ArrayStream::Impl {
+    public:
+        explicit Impl(std::string_view text)
+            // Elements are handed out one by one and may outlive each other,
+            // so they are allocated from the heap rather than from a shared arena
+            : parser_(text, pmr::get_default_resource()) {
+            parser_.Expect('[');
+        }
+
+        explicit Impl(StreamReader& reader)
+            : parser_({}, pmr::get_default_resource())
+            , reader_(&reader) {
+            reader.Expect('[');
+        }
+
+        std::optional<Node> Next() {
+            if (finished_) {
+                return std::nullopt;
+            }
+            std::optional<Node> element = reader_ ? ReadNextElement() : parser_.LoadNextElement();
+            finished_ = !element.has_value();
+            return element;
+        }
+
+    private:
+        // Each element is cut out of the reader and parsed on its own
+        std::optional<Node> ReadNextElement() {
+            int c = reader_->Peek();
+            if (c == ']') {
+                reader_->Expect(']');
+                return std::nullopt;
+            }
+            if (c == ',') {
+                reader_->Expect(',');
+                c = reader_->Peek();
+            }
+            if (c == EOF) {
+                throw ParsingError("Array parsing error");
+            }
+            reader_->ReadValueText(element_text_);
+            parser_.Reset(element_text_);
+            return parser_.LoadNode();
+        }
+
+        Parser parser_;
+        StreamReader* reader_ = nullptr;
+        std::string element_text_;
+        bool finished_ = false;
+    };
+
+    ArrayStream::ArrayStream(std::string_view text)
+        : impl_(std::make_unique<Impl>(text)) {
+    }
+
+    ArrayStream::ArrayStream(StreamReader& reader)
+        : impl_(std::make_unique<Impl>(reader)) {
+    }
+
+    ArrayStream::~ArrayStream() = default;
+
+    std::optional<Node> ArrayStream::Next() {
+        return impl_->Next();
+    }
+
+    Document Load(std::string_view text) {
+        auto arena = std::make_unique<std::pmr::monotonic_buffer_resource>(ARENA_INITIAL_SIZE);
+        Node root = Parser(text, arena.get()).LoadNode();
+        return Document{ move(root), move(arena) };
     }
 
     void Print(const Document& doc, std::ostream& output) {
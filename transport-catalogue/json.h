@@ -1,20 +1,74 @@
 #pragma once
 
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <variant>
 
 namespace json {
 
     class Node;
-    //   Dict  Array  
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+
+    // Arrays and dicts use polymorphic allocators: nodes produced by json::Load live in
+    // the document arena, nodes built by hand (and every copy) live in the regular heap
+    using Array = std::pmr::vector<Node>;
+
+    // Flat dictionary: entries are kept sorted by key in a single contiguous block.
+    // Lookups take std::string_view, so no temporary std::string is built for a key
+    class Dict {
+    public:
+        using key_type = std::pmr::string;
+        using value_type = std::pair<key_type, Node>;
+        using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+        using Entries = std::pmr::vector<value_type>;
+        using iterator = Entries::iterator;
+        using const_iterator = Entries::const_iterator;
+
+        Dict() = default;
+        explicit Dict(const allocator_type& alloc);
+        Dict(std::initializer_list<std::pair<std::string_view, Node>> entries);
+
+        Node& at(std::string_view key);
+        const Node& at(std::string_view key) const;
+        Node& operator[](std::string_view key);
+
+        iterator find(std::string_view key);
+        const_iterator find(std::string_view key) const;
+        size_t count(std::string_view key) const;
+
+        std::pair<iterator, bool> insert(std::pair<std::string_view, Node> entry);
+        std::pair<iterator, bool> emplace(std::string_view key, Node value);
+
+        iterator begin() { return entries_.begin(); }
+        iterator end() { return entries_.end(); }
+        const_iterator begin() const { return entries_.begin(); }
+        const_iterator end() const { return entries_.end(); }
+        size_t size() const { return entries_.size(); }
+        bool empty() const { return entries_.empty(); }
+        void reserve(size_t capacity) { entries_.reserve(capacity); }
+        allocator_type get_allocator() const { return entries_.get_allocator(); }
+
+        bool operator==(const Dict& other) const;
+        bool operator!=(const Dict& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        iterator LowerBound(std::string_view key);
+        const_iterator LowerBound(std::string_view key) const;
+
+        Entries entries_;
+    };
+
     using NodeData = std::variant<std::nullptr_t, int, double, std::string, bool, Array, Dict>;
 
-    //        JSON
+    // Эта ошибка должна выбрасываться при ошибках парсинга JSON
     class ParsingError : public std::runtime_error {
     public:
         using runtime_error::runtime_error;
@@ -53,7 +107,7 @@ namespace json {
         }
 
         bool operator==(const Node& other) const {
-            return *this == other;
+            return GetNodeData() == other.GetNodeData();
         }
 
         bool operator!=(const Node& other) const {
@@ -65,6 +119,10 @@ namespace json {
     public:
         Document() = default;
         explicit Document(Node root);
+        Document(Node root, std::unique_ptr<std::pmr::memory_resource> arena);
+
+        Document(Document&& other) = default;
+        Document& operator=(Document&& other) noexcept;
 
         const Node& GetRoot() const;
         bool operator==(const Document& other) const {
@@ -75,10 +133,64 @@ namespace json {
         }
 
     private:
+        // The arena must outlive root_, so it is declared first
+        std::unique_ptr<std::pmr::memory_resource> arena_;
         Node root_;
     };
 
     Document Load(std::istream& input);
+    Document Load(std::string_view text);
+
+    // Returns the members of the object in text with their values left unparsed,
+    // so a caller can pick the parts it needs and parse them separately
+    std::vector<std::pair<std::string, std::string_view>> SplitObject(std::string_view text);
+
+    // Reads a document from a stream in chunks of chunk_size bytes, value by value: at any
+    // time only one chunk and the value being read are held in memory
+    class StreamReader {
+    public:
+        static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+        explicit StreamReader(std::istream& input, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+        // Skips whitespace and returns the next character without consuming it, or EOF
+        int Peek();
+        void Expect(char c);
+
+        // Returns the key of the next member of an object whose '{' was consumed, with
+        // the ':' after it, or std::nullopt once the closing brace is reached
+        std::optional<std::string> NextKey();
+        // Consumes the next value, replacing text with its unparsed text
+        void ReadValueText(std::string& text);
+        void SkipValue();
+
+    private:
+        bool Fill();
+        void ReadValue(std::string* text);
+
+        std::istream& input_;
+        size_t chunk_size_;
+        std::string chunk_;
+        size_t pos_ = 0;
+    };
+
+    // Parses an array one element at a time, letting callers start working on the first
+    // elements before the rest has been read
+    class ArrayStream {
+    public:
+        explicit ArrayStream(std::string_view text);
+        // The array that comes next in reader, read from it element by element;
+        // the reader must not be used elsewhere until Next() returns std::nullopt
+        explicit ArrayStream(StreamReader& reader);
+        ~ArrayStream();
+
+        // Returns std::nullopt once the closing bracket is reached
+        std::optional<Node> Next();
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> impl_;
+    };
 
     struct PrintContext {
         std::ostream& out;
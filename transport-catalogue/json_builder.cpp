@@ -5,8 +5,8 @@
 namespace json {
 	using namespace std::literals;
 
-	DictValueContext BaseContext::Key(std::string value) {
-		return { builder_.Key(value) };
+	DictValueContext BaseContext::Key(std::string_view key) {
+		return { builder_.Key(key) };
 	}
 	DictKeyContext BaseContext::StartDict() {
 		return DictKeyContext(builder_.StartDict());
@@ -22,21 +22,19 @@ namespace json {
 	}
 
 	DictKeyContext DictValueContext::Value(Node::Value value) {
-		return DictKeyContext(builder_.Value(value));
+		return DictKeyContext(builder_.Value(std::move(value)));
 	}
 
 	ArrayContext ArrayContext::Value(Node::Value value) {
-		return ArrayContext(builder_.Value(value));
+		return ArrayContext(builder_.Value(std::move(value)));
 	}
 
-	DictValueContext Builder::Key(std::string key) {
+	DictValueContext Builder::Key(std::string_view key) {
 		if (last_method_called_ == POSSIBLE_METHOD_CALLS::KEY || !nodes_stack_.top()->IsMap()) {
 			throw std::logic_error("Can't call key outside the Dict"s);
 		}
 		last_method_called_ = POSSIBLE_METHOD_CALLS::KEY;
-		last_called_key_ = std::move(key);
-
-		((nodes_stack_.top())->AsMap()).insert({ last_called_key_, nullptr });
+		key_value_slot_ = &((nodes_stack_.top())->AsMap())[key];
 
 		return DictValueContext(*this);
 	}
@@ -50,15 +48,15 @@ namespace json {
 		}
 
 		if (last_method_called_ == POSSIBLE_METHOD_CALLS::CONSTRUCTOR) {
-			root_.GetValue() = value;
+			root_.GetValue() = std::move(value);
 			nodes_stack_.push(&root_);
 		}
 		else if (nodes_stack_.top()->IsArray()) {
-			Node& inserted_into_array = ((nodes_stack_.top())->AsArray()).emplace_back(Node());
-			inserted_into_array.GetValue() = value;
+			Node& inserted_into_array = ((nodes_stack_.top())->AsArray()).emplace_back();
+			inserted_into_array.GetValue() = std::move(value);
 		}
 		else if (nodes_stack_.top()->IsMap()) {
-			((nodes_stack_.top())->AsMap())[last_called_key_].GetValue() = value;
+			key_value_slot_->GetValue() = std::move(value);
 		}
 		last_method_called_ = POSSIBLE_METHOD_CALLS::VALUE;
 		return *this;
@@ -77,9 +75,8 @@ namespace json {
 			nodes_stack_.push(&root_);
 		}
 		else if (last_method_called_ == POSSIBLE_METHOD_CALLS::KEY) {
-			Node& last_dict_value = ((nodes_stack_.top())->AsMap())[last_called_key_];
-			last_dict_value = Dict();
-			nodes_stack_.push(&last_dict_value);
+			*key_value_slot_ = Dict();
+			nodes_stack_.push(key_value_slot_);
 		}
 		else if (nodes_stack_.top()->IsArray()) {
 			Node& emplaced_into_array = ((nodes_stack_.top())->AsArray()).emplace_back(Dict());
@@ -103,9 +100,8 @@ namespace json {
 			nodes_stack_.push(&root_);
 		}
 		else if (last_method_called_ == POSSIBLE_METHOD_CALLS::KEY) {
-			Node& last_dict_value = ((nodes_stack_.top())->AsMap())[last_called_key_];
-			last_dict_value = Array();
-			nodes_stack_.push(&last_dict_value);
+			*key_value_slot_ = Array();
+			nodes_stack_.push(key_value_slot_);
 		}
 		else if (nodes_stack_.top()->IsArray()) {
 			Node& emplaced_into_array = ((nodes_stack_.top())->AsArray()).emplace_back(Array());
@@ -136,6 +132,6 @@ namespace json {
 		if (nodes_stack_.size() > 1 || last_method_called_ == POSSIBLE_METHOD_CALLS::CONSTRUCTOR) {
 			throw std::logic_error("Building error");
 		}
-		return root_;
+		return std::move(root_);
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "json.h"
 #include <stack>
 #include <string>
+#include <string_view>
 
 namespace json {
 
@@ -18,7 +19,7 @@ namespace json {
 			: builder_(builder)
 		{}
 
-		DictValueContext Key(std::string value);
+		DictValueContext Key(std::string_view key);
 		DictKeyContext StartDict();
 		ArrayContext StartArray();
 		Builder& EndDict();
@@ -68,12 +69,13 @@ namespace json {
 			, last_method_called_(POSSIBLE_METHOD_CALLS::CONSTRUCTOR)
 		{}
 
-		DictValueContext Key(std::string value);
+		DictValueContext Key(std::string_view key);
 		Builder& Value(Node::Value value);
 		DictKeyContext StartDict();
 		ArrayContext StartArray();
 		Builder& EndDict();
 		Builder& EndArray();
+		// Moves the finished tree out; the builder must not be used afterwards
 		Node Build();
 
 	private:
@@ -90,7 +92,8 @@ namespace json {
 			END_ARRAY
 		} last_method_called_ = POSSIBLE_METHOD_CALLS::CONSTRUCTOR;
 
-		std::string last_called_key_;
+		// Slot inserted by the last Key() call, filled by the next value
+		Node* key_value_slot_ = nullptr;
 	};
 
 } // namespace json
\ No newline at end of file
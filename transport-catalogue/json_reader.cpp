@@ -1,12 +1,17 @@
 #include "json_reader.h"
+#include "profile.h"
 
 
+#include <algorithm>
+#include <chrono>
 #include <set>
 #include <string_view>
 #include <optional>
 #include <unordered_set>
 #include <sstream>
+#include <stdexcept>
 #include <fstream>
+#include <thread>
 
 using namespace std::literals;
 
@@ -14,64 +19,164 @@ namespace transport_catalogue {
 	namespace json_handler {
 
 		void JsonReader::LoadJSON(std::istream& input) {
+			PROFILE_PHASE(PARSE_JSON);
 			json_document_ = json::Load(input);
 			//ParseJsonDocument();
 		}
 
 		// ------------------------ Base requests processing ------------------------ //
 		void JsonReader::ProcessBaseRequests(/*const json::Node& base_root*/) {
-			json::Array requests_array = json_document_.GetRoot().AsMap().at("base_requests"s).AsArray();
+			AddBaseRequests();
+			catalogue_.BuildGraph();
+			catalogue_.Freeze();
+		}
+
+		void JsonReader::ProcessBaseRequests(concurrency::WorkStealingPool& pool) {
+			AddBaseRequests(pool);
+			catalogue_.BuildGraph(pool);
+			catalogue_.Freeze();
+		}
+
+		void JsonReader::AddBaseRequests() {
+			const json::Array& requests_array = json_document_.GetRoot().AsMap().at("base_requests"sv).AsArray();
 
 			// Loop 1 - process stops
 			for (const json::Node& single_request : requests_array) {   // [ {...}, {...}, {...}, ... ]
-				std::string request_type = ((single_request.AsMap()).at("type"s)).AsString();
-				if (request_type == "Stop"s) {
+				const std::string& request_type = ((single_request.AsMap()).at("type"sv)).AsString();
+				if (request_type == "Stop"sv) {
 					ParseStopWithoutDistances(single_request);
 				}
 			}
 
 			// Loop 2 - process road_distances between stops
 			for (const json::Node& single_request : requests_array) {   // [ {...}, {...}, {...}, ... ]
-				std::string request_type = ((single_request.AsMap()).at("type"s)).AsString();
-				if (request_type == "Stop"s) {
+				const std::string& request_type = ((single_request.AsMap()).at("type"sv)).AsString();
+				if (request_type == "Stop"sv) {
 					ParseDistance(single_request);
 				}
 			}
 
 			// Loop 3 - process buses
 			for (const json::Node& single_request : requests_array) {   // [ {...}, {...}, {...}, ... ]
-				std::string request_type = ((single_request.AsMap()).at("type"s)).AsString();
-				if (request_type == "Bus"s) {
+				const std::string& request_type = ((single_request.AsMap()).at("type"sv)).AsString();
+				if (request_type == "Bus"sv) {
 					ParseBus(single_request);
 				}
 			}
 
 			catalogue_.SetRenderSettings(GetRenderSettings());
 			catalogue_.SetRoutingSettings(GetRoutingSettings());
-			catalogue_.BuildGraph();
+		}
+
+		void JsonReader::AddBaseRequests(concurrency::WorkStealingPool& pool) {
+			constexpr size_t CHUNK_SIZE = 256;
+			struct ParsedDistance {
+				const Stop* to;
+				int distance;
+			};
+
+			const json::Array& requests_array = json_document_.GetRoot().AsMap().at("base_requests"sv).AsArray();
+
+			std::vector<const json::Dict*> stop_requests;
+			std::vector<const json::Dict*> bus_requests;
+			for (const json::Node& single_request : requests_array) {
+				const json::Dict& request = single_request.AsMap();
+				const std::string& request_type = request.at("type"sv).AsString();
+				if (request_type == "Stop"sv) {
+					stop_requests.push_back(&request);
+				}
+				else if (request_type == "Bus"sv) {
+					bus_requests.push_back(&request);
+				}
+			}
+
+			// Stops: the catalogue is filled in order, as the ids are the request order
+			std::vector<geo::Coordinates> coordinates(stop_requests.size());
+			size_t distance_count = 0;
+			pool.ParallelFor(stop_requests.size(), CHUNK_SIZE, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					const json::Dict& request = *stop_requests[i];
+					coordinates[i] = { request.at("latitude"sv).AsDouble(), request.at("longitude"sv).AsDouble() };
+				}
+			});
+			for (const json::Dict* request : stop_requests) {
+				distance_count += request->at("road_distances"sv).AsMap().size();
+			}
+			catalogue_.Reserve(stop_requests.size(), distance_count);
+			for (size_t i = 0; i < stop_requests.size(); ++i) {
+				catalogue_.AddStop(stop_requests[i]->at("name"sv).AsString(), coordinates[i]);
+			}
+
+			// Distances and buses only look stops up until they are added, which is serial
+			// By name, like SetDistance: of two stops with one name, the first gets the distances
+			std::vector<const Stop*> distance_sources(stop_requests.size());
+			std::vector<std::vector<ParsedDistance>> distances(stop_requests.size());
+			pool.ParallelFor(stop_requests.size(), CHUNK_SIZE, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					distance_sources[i] = catalogue_.FindStop(stop_requests[i]->at("name"sv).AsString());
+					for (const auto& [stop_name, dist_node] : stop_requests[i]->at("road_distances"sv).AsMap()) {
+						const Stop* to = catalogue_.FindStop(stop_name);
+						if (!to) {
+							throw std::out_of_range("Unknown stop "s.append(stop_name.data(), stop_name.size()));
+						}
+						distances[i].push_back({ to, dist_node.AsInt() });
+					}
+				}
+			});
+			for (size_t i = 0; i < stop_requests.size(); ++i) {
+				for (const ParsedDistance& distance : distances[i]) {
+					catalogue_.SetDistance(distance_sources[i], distance.to, distance.distance);
+				}
+			}
+
+			std::vector<std::vector<const Stop*>> bus_stops(bus_requests.size());
+			pool.ParallelFor(bus_requests.size(), CHUNK_SIZE, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					const json::Array& stops = bus_requests[i]->at("stops"sv).AsArray();
+					bus_stops[i].reserve(stops.size());
+					for (const json::Node& stop_node : stops) {
+						const std::string_view stop_name = stop_node.AsString();
+						const Stop* stop = catalogue_.FindStop(stop_name);
+						if (!stop) {
+							throw std::out_of_range("Unknown stop "s.append(stop_name));
+						}
+						bus_stops[i].push_back(stop);
+					}
+				}
+			});
+			for (size_t i = 0; i < bus_requests.size(); ++i) {
+				const json::Dict& request = *bus_requests[i];
+				catalogue_.AddBus(request.at("name"sv).AsString(), std::move(bus_stops[i]), request.at("is_roundtrip"sv).AsBool());
+			}
+
+			catalogue_.SetRenderSettings(GetRenderSettings());
+			catalogue_.SetRoutingSettings(GetRoutingSettings());
 		}
 
 		void JsonReader::ParseStopWithoutDistances(const json::Node& stop_node) {
-			json::Dict stop_info_map = stop_node.AsMap();
-			std::string stop_name = stop_info_map.at("name"s).AsString();
-			geo::Coordinates coordinates = { stop_info_map.at("latitude"s).AsDouble(), stop_info_map.at("longitude"s).AsDouble() };
+			const json::Dict& stop_info_map = stop_node.AsMap();
+			const std::string& stop_name = stop_info_map.at("name"sv).AsString();
+			geo::Coordinates coordinates = { stop_info_map.at("latitude"sv).AsDouble(), stop_info_map.at("longitude"sv).AsDouble() };
 			catalogue_.AddStop(stop_name, coordinates);
 		}
 
 		void JsonReader::ParseDistance(const json::Node& stop_node) {
-			std::string current_stop_name = stop_node.AsMap().at("name"s).AsString();
-			json::Dict road_distances = stop_node.AsMap().at("road_distances"s).AsMap();
+			const json::Dict& stop_info_map = stop_node.AsMap();
+			const std::string& current_stop_name = stop_info_map.at("name"sv).AsString();
+			const json::Dict& road_distances = stop_info_map.at("road_distances"sv).AsMap();
 			for (const auto& [stop_name, dist_node] : road_distances) {
 				catalogue_.SetDistance(current_stop_name, stop_name, dist_node.AsInt());
 			}
 		}
 
 		void JsonReader::ParseBus(const json::Node& bus_node) {
-			json::Dict bus_node_as_map = bus_node.AsMap();
-			std::string name = bus_node_as_map.at("name"s).AsString();
-			bool is_roundtrip = bus_node_as_map.at("is_roundtrip"s).AsBool();
-			std::vector<std::string> stop_names;
-			for (const json::Node& stop_node : bus_node_as_map.at("stops"s).AsArray()) {
+			const json::Dict& bus_node_as_map = bus_node.AsMap();
+			const std::string& name = bus_node_as_map.at("name"sv).AsString();
+			bool is_roundtrip = bus_node_as_map.at("is_roundtrip"sv).AsBool();
+			const json::Array& stops = bus_node_as_map.at("stops"sv).AsArray();
+			std::vector<std::string_view> stop_names;
+			stop_names.reserve(stops.size());
+			for (const json::Node& stop_node : stops) {
 				stop_names.push_back(stop_node.AsString());
 			}
 			catalogue_.AddBus(name, stop_names, is_roundtrip);
@@ -80,164 +185,347 @@ namespace transport_catalogue {
 
 
 		//-------------------- Stat requests processing ------------------------//
-		void JsonReader::ProcessStatRequests(std::ostream& output) const {
-			json::Array requests_array = json_document_.GetRoot().AsMap().at("stat_requests"s).AsArray();
-			json::Builder builder{};
-			json::ArrayContext arr_ctx = builder.StartArray();
+		// Responses are written straight into the writer, keys in the same (sorted)
+		// order json::Dict used to print them, so the request path builds no Node trees
+		void JsonReader::ProcessStatRequests(std::ostream& output, json::Writer::Format format) const {
+			const json::Array& requests_array = json_document_.GetRoot().AsMap().at("stat_requests"sv).AsArray();
 			const TransportCatalogue::Graph& gr = catalogue_.GetGraphConstRef();
 			graph::Router router(gr);
+			ProcessStatRequests(requests_array, router, output, format);
+		}
 
+		void JsonReader::ProcessStatRequests(const json::Array& requests_array, const Router& router,
+			std::ostream& output, json::Writer::Format format) const {
+			PROFILE_PHASE(ANSWER_REQUESTS);
+			// Every response goes to the output buffer as soon as it is computed
+			json::Writer writer(output, format);
+			writer.StartArray();
 			for (const json::Node& single_request : requests_array) {
-				std::string request_type = ((single_request.AsMap()).at("type"s)).AsString();
-				if (request_type == "Stop"s) {
-					arr_ctx.Value(ProcessStopStatRequest(single_request));
+				ProcessStatRequest(single_request.AsMap(), router, writer);
+			}
+			writer.EndArray();
+			writer.Flush();
+		}
+
+		void JsonReader::ProcessStatRequests(std::ostream& output, concurrency::WorkStealingPool& pool,
+			json::Writer::Format format) const {
+			// Requests are computed block by block, so only one block of responses is held at a time
+			constexpr size_t BLOCK_SIZE = 16384;
+			// Small enough for stealing to even out a few slow requests, large enough
+			// to keep the queue traffic negligible
+			constexpr size_t CHUNK_SIZE = 32;
+
+			const json::Array& requests_array = json_document_.GetRoot().AsMap().at("stat_requests"sv).AsArray();
+			const TransportCatalogue::Graph& gr = catalogue_.GetGraphConstRef();
+			const Router router(gr);
+
+			// A map is rendered once for all Map requests; render it on the whole pool up front
+			const bool has_map_request = std::any_of(requests_array.begin(), requests_array.end(),
+				[](const json::Node& request) {
+					return request.AsMap().at("type"sv).AsString() == "Map"sv;
+				});
+			if (has_map_request) {
+				catalogue_.GetRenderedMap(&pool);
+			}
+
+			PROFILE_PHASE(ANSWER_REQUESTS);
+			json::Writer writer(output, format);
+			writer.StartArray();
+			std::vector<std::string> responses;
+			for (size_t block = 0; block < requests_array.size(); block += BLOCK_SIZE) {
+				const size_t block_size = std::min(BLOCK_SIZE, requests_array.size() - block);
+				responses.assign(block_size, std::string());
+				// The catalogue and the router are only read here
+				pool.ParallelFor(block_size, CHUNK_SIZE, [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; ++i) {
+						json::Writer response_writer(responses[i], output, format);
+						response_writer.SetDepth(1);
+						ProcessStatRequest(requests_array[block + i].AsMap(), router, response_writer);
+					}
+				});
+				for (const std::string& response : responses) {
+					// Requests of unknown type have no response
+					if (!response.empty()) {
+						writer.RawValue(response);
+					}
 				}
-				else if (request_type == "Bus"s) {
-					arr_ctx.Value(ProcessBusStatRequest(single_request));
+			}
+			writer.EndArray();
+			writer.Flush();
+		}
+
+		void JsonReader::ProcessStatRequests(std::ostream& output, concurrency::RequestScheduler& scheduler,
+			json::Writer::Format format) const {
+			constexpr size_t BLOCK_SIZE = 16384;
+
+			const json::Array& requests_array = json_document_.GetRoot().AsMap().at("stat_requests"sv).AsArray();
+			const Router router(catalogue_.GetGraphConstRef());
+
+			PROFILE_PHASE(ANSWER_REQUESTS);
+			json::Writer writer(output, format);
+			writer.StartArray();
+			std::vector<std::string> responses;
+			for (size_t block = 0; block < requests_array.size(); block += BLOCK_SIZE) {
+				const size_t block_size = std::min(BLOCK_SIZE, requests_array.size() - block);
+				responses.assign(block_size, std::string());
+				concurrency::TaskGroup group(scheduler);
+				for (size_t i = 0; i < block_size; ++i) {
+					const json::Node& request = requests_array[block + i];
+					group.Submit(static_cast<size_t>(GetRequestType(request)), [&, i] {
+						json::Writer response_writer(responses[i], output, format);
+						response_writer.SetDepth(1);
+						ProcessStatRequest(request.AsMap(), router, response_writer);
+					});
 				}
-				else if (request_type == "Map"s) {
-					arr_ctx.Value(ProcessMapStatRequest(single_request));
+				group.Wait();
+				for (const std::string& response : responses) {
+					if (!response.empty()) {
+						writer.RawValue(response);
+					}
 				}
-				else if (request_type == "Route"s) {
-					arr_ctx.Value(ProcessRouteStatRequest(single_request, router));
-				} 
 			}
-			json::Builder result = arr_ctx.EndArray();
-			json::Print(json::Document(result.Build()), output);
+			writer.EndArray();
+			writer.Flush();
 		}
 
-		json::Dict JsonReader::ProcessStopStatRequest(const json::Node& stop_node) const {
-			int request_id = stop_node.AsMap().at("id"s).AsInt();
-			std::string name = stop_node.AsMap().at("name"s).AsString();
-			if (!catalogue_.FindStop(name)) {
-				return { {"request_id"s, json::Node(request_id)}, {"error_message"s, json::Node("not found"s)} };
+		RequestType GetRequestType(const json::Node& request) {
+			if (!request.IsMap()) {
+				return RequestType::OTHER;
+			}
+			const json::Dict& request_map = request.AsMap();
+			const auto it = request_map.find("type"sv);
+			if (it == request_map.end() || !it->second.IsString()) {
+				return RequestType::OTHER;
+			}
+			const std::string& type = it->second.AsString();
+			if (type == "Stop"sv) {
+				return RequestType::STOP;
 			}
-			std::set<std::string_view> buses_passing_through_current_stop = catalogue_.GetBusesByStop(name);
-			json::Array buses_array;
-			for (std::string_view bus_sv : buses_passing_through_current_stop) {
-				buses_array.push_back(json::Node(std::string(bus_sv)));
+			if (type == "Bus"sv) {
+				return RequestType::BUS;
 			}
-			return { {"buses"s, json::Node(buses_array)}, {"request_id"s, json::Node(request_id)} };
+			if (type == "Route"sv) {
+				return RequestType::ROUTE;
+			}
+			if (type == "Map"sv) {
+				return RequestType::MAP;
+			}
+			return RequestType::OTHER;
 		}
 
-		size_t CountUniqueStops(const std::vector<const Stop*>& stops) {
-			size_t unique_stops_count = 0;
-			std::unordered_set<std::string> unique_stops;
-			for (const Stop* stop : stops) {
-				if (unique_stops.insert(stop->name).second) {
-					unique_stops_count++;
+		void CheckStatRequest(const json::Node& request) {
+			if (!request.IsMap()) {
+				throw std::invalid_argument("the request is not a dict"s);
+			}
+			const json::Dict& request_map = request.AsMap();
+			auto require = [&request_map](std::string_view key, bool (json::Node::*has_type)() const,
+				std::string_view type_name) {
+				const auto it = request_map.find(key);
+				if (it == request_map.end()) {
+					throw std::invalid_argument("\""s.append(key).append("\" is missing"sv));
 				}
+				if (!(it->second.*has_type)()) {
+					throw std::invalid_argument("\""s.append(key).append("\" must be "sv).append(type_name));
+				}
+			};
+			require("type"sv, &json::Node::IsString, "a string"sv);
+			const RequestType type = GetRequestType(request);
+			if (type == RequestType::OTHER) {
+				return;
+			}
+			require("id"sv, &json::Node::IsInt, "an integer"sv);
+			if (type == RequestType::STOP || type == RequestType::BUS) {
+				require("name"sv, &json::Node::IsString, "a string"sv);
+			}
+			else if (type == RequestType::ROUTE) {
+				require("from"sv, &json::Node::IsString, "a string"sv);
+				require("to"sv, &json::Node::IsString, "a string"sv);
 			}
-			return unique_stops_count;
 		}
 
-		json::Dict JsonReader::ProcessBusStatRequest(const json::Node& bus_node) const {
-			int request_id = bus_node.AsMap().at("id"s).AsInt();
-			std::string name = bus_node.AsMap().at("name"s).AsString();
-			std::optional<Bus> bus = catalogue_.FindBus(name);
-			if (!bus.has_value()) {
-				return { {"request_id"s, json::Node(request_id)}, {"error_message"s, json::Node("not found"s)} };
+		std::vector<concurrency::RequestScheduler::ClassSettings> MakeRequestClasses(size_t thread_count) {
+			using namespace std::chrono_literals;
+			if (thread_count == 0) {
+				thread_count = std::max(1u, std::thread::hardware_concurrency());
 			}
+			std::vector<concurrency::RequestScheduler::ClassSettings> classes(static_cast<size_t>(RequestType::COUNT));
+			classes[static_cast<size_t>(RequestType::STOP)] = { 20us };
+			classes[static_cast<size_t>(RequestType::BUS)] = { 10us };
+			classes[static_cast<size_t>(RequestType::ROUTE)] = { 100us };
+			classes[static_cast<size_t>(RequestType::MAP)] = { 20ms, std::max<size_t>(1, thread_count / 2) };
+			classes[static_cast<size_t>(RequestType::OTHER)] = { 1ms };
+			return classes;
+		}
 
-			int stops_count;
-			if (!(*bus).is_roundtrip) {
-				stops_count = (*bus).stops.size() * 2 - 1;
+		void JsonReader::ProcessStatRequest(const json::Dict& request, const Router& router, json::Writer& writer) const {
+			const std::string& request_type = request.at("type"sv).AsString();
+			if (request_type == "Stop"sv) {
+				PROFILE_LATENCY(STOP_REQUEST);
+				ProcessStopStatRequest(request, writer);
 			}
-			else {
-				stops_count = (*bus).stops.size();
+			else if (request_type == "Bus"sv) {
+				PROFILE_LATENCY(BUS_REQUEST);
+				ProcessBusStatRequest(request, writer);
+			}
+			else if (request_type == "Map"sv) {
+				PROFILE_LATENCY(MAP_REQUEST);
+				ProcessMapStatRequest(request, writer);
+			}
+			else if (request_type == "Route"sv) {
+				PROFILE_LATENCY(ROUTE_REQUEST);
+				ProcessRouteStatRequest(request, router, writer);
 			}
-			int road_route_length = ComputeRouteLength(*bus).first;
-			double geo_route_length = ComputeRouteLength(*bus).second;
-			double curvature = road_route_length / geo_route_length;
-			int unique_stops_count = CountUniqueStops((*bus).stops);
-			return
-			{
-				{"request_id"s, json::Node(request_id)},
-				{"stop_count"s, json::Node(stops_count)},
-				{"unique_stop_count"s, json::Node(unique_stops_count)},
-				{"route_length"s, json::Node(road_route_length)},
-				{"curvature"s, json::Node(curvature)}
-			};
 		}
 
-		json::Dict JsonReader::ProcessMapStatRequest(const json::Node& map_node) const {
-			int request_id = map_node.AsMap().at("id"s).AsInt();
-			map_renderer::MapRenderer map_renderer(catalogue_.GetRenderSettings(), catalogue_.GetBusnameToBusMap());
-			map_renderer.SetScalingSettings(catalogue_.GetEveryBusPointCoordinates());
+		namespace {
+			void WriteError(int request_id, std::string_view message, json::Writer& writer) {
+				writer.StartDict()
+					.Key("error_message"sv).Value(message)
+					.Key("request_id"sv).Value(request_id)
+					.EndDict();
+			}
 
-			std::ostringstream map_oss;
-			(map_renderer.RenderMap()).Render(map_oss);
+			void WriteNotFound(int request_id, json::Writer& writer) {
+				WriteError(request_id, "not found"sv, writer);
+			}
 
-			return { {"request_id"s, request_id}, {"map"s, map_oss.str()} };
+			// Reads the optional "bbox": [min_x, min_y, max_x, max_y] (pixels of the full map)
+			// and "zoom" of a Map request. Returns nullopt for the whole map at its own scale,
+			// and throws std::invalid_argument if either is malformed
+			std::optional<map_renderer::Viewport> ParseViewport(const json::Dict& request,
+				const map_renderer::detail::RenderSettings& settings) {
+				const auto bbox_it = request.find("bbox"sv);
+				const auto zoom_it = request.find("zoom"sv);
+				if (bbox_it == request.end() && zoom_it == request.end()) {
+					return std::nullopt;
+				}
+				map_renderer::Viewport viewport;
+				viewport.area = { 0.0, 0.0, settings.width, settings.height };
+				if (bbox_it != request.end()) {
+					const json::Array& bbox = bbox_it->second.AsArray();
+					if (bbox.size() != 4) {
+						throw std::invalid_argument("bbox must hold four numbers"s);
+					}
+					viewport.area = { bbox[0].AsDouble(), bbox[1].AsDouble(), bbox[2].AsDouble(), bbox[3].AsDouble() };
+				}
+				if (zoom_it != request.end()) {
+					viewport.zoom = zoom_it->second.AsDouble();
+				}
+				if (!(viewport.area.min_x <= viewport.area.max_x && viewport.area.min_y <= viewport.area.max_y
+					&& viewport.zoom > 0)) {
+					throw std::invalid_argument("empty viewport"s);
+				}
+				return viewport;
+			}
 		}
 
-		json::Dict JsonReader::ProcessRouteStatRequest(const json::Node& route_node, const Router& router) const {
-			int request_id = route_node.AsMap().at("id"s).AsInt();
-			
-			std::string from = route_node.AsMap().at("from"s).AsString();
-			size_t from_id = catalogue_.GetVertexIdByStopName(from);
-			std::string to = route_node.AsMap().at("to"s).AsString();
-			size_t to_id = catalogue_.GetVertexIdByStopName(to);
-			std::optional<TransportCatalogue::Route> route = router.BuildRoute(from_id, to_id);
-			if (!route.has_value()) {
-				return { {"request_id"s, request_id}, {"error_message"s, "not found"s}};
-			}
-			else if ((*route).edges.empty()) {
-				return
-				{
-					{"request_id"s, request_id},
-					{"total_time"s, 0},
-					{"items"s, json::Array(0)}
-				};
-			}
-
-			json::Builder builder{};
-			json::ArrayContext arr_ctx = builder.StartDict()
-													.Key("request_id").Value(request_id)
-													.Key("total_time"s).Value((*route).weight)
-													.Key("items"s).StartArray();
-
-			int bus_waiting_time = catalogue_.GetBusWaitingTime();
-			std::string_view waiting_stop;
-			std::string bus_name;
-			double travel_time;
-			int span_count;
-
-			for (graph::EdgeId edge_id : (*route).edges) {
-				waiting_stop = catalogue_.GetEdgeStops(edge_id).first;
-				bus_name = catalogue_.GetEdgeBusName(edge_id);
-				travel_time = catalogue_.GetEdgeWeight(edge_id) - bus_waiting_time;
-				span_count = catalogue_.GetEdgeSpanCount(edge_id);
-				arr_ctx.StartDict()
-							.Key("type"s).Value("Wait"s)
-							.Key("stop_name"s).Value(std::string(waiting_stop))
-							.Key("time").Value(bus_waiting_time)
-						.EndDict()
-						.StartDict()
-							.Key("type"s).Value("Bus"s)
-							.Key("bus").Value(std::string(bus_name))
-							.Key("span_count"s).Value(span_count)
-							.Key("time").Value(travel_time)
-						.EndDict();
-			}
-			return arr_ctx.EndArray().Build().AsMap();
+		void JsonReader::ProcessStopStatRequest(const json::Dict& request, json::Writer& writer) const {
+			int request_id = request.at("id"sv).AsInt();
+			const CatalogueView& view = catalogue_.GetView();
+			const Stop* stop = view.FindStop(request.at("name"sv).AsString());
+			if (!stop) {
+				WriteNotFound(request_id, writer);
+				return;
+			}
+			writer.StartDict().Key("buses"sv).StartArray();
+			for (std::string_view bus_sv : view.GetBusesByStop(*stop)) {
+				writer.Value(bus_sv);
+			}
+			writer.EndArray()
+				.Key("request_id"sv).Value(request_id)
+				.EndDict();
 		}
 
-		std::pair<int, double> JsonReader::ComputeRouteLength(const Bus& bus) const {
-			double geo_distance = 0;
-			int real_distance = 0;
-			for (size_t i = 0; i < bus.stops.size() - 1; i++) {
-				geo_distance += geo::ComputeDistance(bus.stops[i]->coords, bus.stops[i + 1]->coords);
-				real_distance += catalogue_.GetDistance(bus.stops[i]->name, bus.stops[i + 1]->name);
+		void JsonReader::ProcessBusStatRequest(const json::Dict& request, json::Writer& writer) const {
+			int request_id = request.at("id"sv).AsInt();
+			const CatalogueView& view = catalogue_.GetView();
+			const Bus* bus = view.FindBus(request.at("name"sv).AsString());
+			if (!bus) {
+				WriteNotFound(request_id, writer);
+				return;
 			}
-			if (!bus.is_roundtrip) {
-				for (size_t i = 0; i < bus.stops.size() - 1; i++) {
-					real_distance += catalogue_.GetDistance(bus.stops[i + 1]->name, bus.stops[i]->name);
-				}
-				geo_distance *= 2;
+
+			const BusStats& stats = view.GetBusStats(*bus);
+			writer.StartDict()
+				.Key("curvature"sv).Value(stats.curvature)
+				.Key("request_id"sv).Value(request_id)
+				.Key("route_length"sv).Value(stats.route_length)
+				.Key("stop_count"sv).Value(stats.stop_count)
+				.Key("unique_stop_count"sv).Value(stats.unique_stop_count)
+				.EndDict();
+		}
+
+		void JsonReader::ProcessMapStatRequest(const json::Dict& request, json::Writer& writer) const {
+			int request_id = request.at("id"sv).AsInt();
+			std::optional<map_renderer::Viewport> viewport;
+			try {
+				viewport = ParseViewport(request, catalogue_.GetView().GetRenderSettings());
+			}
+			catch (const std::exception&) {
+				WriteError(request_id, "invalid viewport"sv, writer);
+				return;
 			}
+			if (!viewport) {
+				writer.StartDict()
+					.Key("map"sv).Value(catalogue_.GetRenderedMap())
+					.Key("request_id"sv).Value(request_id)
+					.EndDict();
+				return;
+			}
+			// Tiles differ from request to request and are not cached; the markup is escaped
+			// into the response chunk by chunk as it is rendered
+			writer.StartDict()
+				.Key("map"sv).StartString();
+			std::string chunk;
+			svg::Writer tile_writer(chunk, [&writer](std::string_view markup) {
+				writer.AppendString(markup);
+			});
+			catalogue_.GetMapRenderer().RenderViewport(tile_writer, *viewport);
+			tile_writer.Flush();
+			writer.EndString()
+				.Key("request_id"sv).Value(request_id)
+				.EndDict();
+		}
+
+		void JsonReader::ProcessRouteStatRequest(const json::Dict& request, const Router& router, json::Writer& writer) const {
+			int request_id = request.at("id"sv).AsInt();
+			const CatalogueView& view = catalogue_.GetView();
 
-			return { real_distance, geo_distance };
+			const Stop* from = view.FindStop(request.at("from"sv).AsString());
+			const Stop* to = view.FindStop(request.at("to"sv).AsString());
+			std::optional<TransportCatalogue::Route> route;
+			if (from && to) {
+				route = router.BuildRoute(from->id, to->id);
+			}
+			if (!route.has_value()) {
+				WriteNotFound(request_id, writer);
+				return;
+			}
+
+			writer.StartDict().Key("items"sv).StartArray();
+			int bus_waiting_time = view.GetBusWaitingTime();
+			for (graph::EdgeId edge_id : route->edges) {
+				const auto& edge = view.GetGraph().GetEdge(edge_id);
+				writer.StartDict()
+						.Key("stop_name"sv).Value(view.GetStop(edge.from).name)
+						.Key("time"sv).Value(bus_waiting_time)
+						.Key("type"sv).Value("Wait"sv)
+					.EndDict()
+					.StartDict()
+						.Key("bus"sv).Value(edge.bus_name)
+						.Key("span_count"sv).Value(static_cast<int>(edge.span_count))
+						.Key("time"sv).Value(edge.weight - bus_waiting_time)
+						.Key("type"sv).Value("Bus"sv)
+					.EndDict();
+			}
+			writer.EndArray().Key("request_id"sv).Value(request_id).Key("total_time"sv);
+			if (route->edges.empty()) {
+				writer.Value(0);
+			}
+			else {
+				writer.Value(route->weight);
+			}
+			writer.EndDict();
 		}
 
 		//------------------- Render settings processing ---------------------//
@@ -262,28 +550,28 @@ namespace transport_catalogue {
 
 		map_renderer::detail::RenderSettings JsonReader::GetRenderSettings() const {
 			map_renderer::detail::RenderSettings result;
-			json::Dict render_settings_json_map = json_document_.GetRoot().AsMap().at("render_settings"s).AsMap();
-			result.width = render_settings_json_map.at("width"s).AsDouble();
-			result.height = render_settings_json_map.at("height"s).AsDouble();
-			result.padding = render_settings_json_map.at("padding"s).AsDouble();
-			result.line_width = render_settings_json_map.at("line_width"s).AsDouble();
-			result.stop_radius = render_settings_json_map.at("stop_radius"s).AsDouble();
-			result.bus_label_font_size = render_settings_json_map.at("bus_label_font_size"s).AsInt();
+			const json::Dict& render_settings_json_map = json_document_.GetRoot().AsMap().at("render_settings"sv).AsMap();
+			result.width = render_settings_json_map.at("width"sv).AsDouble();
+			result.height = render_settings_json_map.at("height"sv).AsDouble();
+			result.padding = render_settings_json_map.at("padding"sv).AsDouble();
+			result.line_width = render_settings_json_map.at("line_width"sv).AsDouble();
+			result.stop_radius = render_settings_json_map.at("stop_radius"sv).AsDouble();
+			result.bus_label_font_size = render_settings_json_map.at("bus_label_font_size"sv).AsInt();
 			result.bus_label_offset =
 			{
-				(render_settings_json_map.at("bus_label_offset"s).AsArray()[0]).AsDouble(),
-				(render_settings_json_map.at("bus_label_offset"s).AsArray()[1]).AsDouble()
+				(render_settings_json_map.at("bus_label_offset"sv).AsArray()[0]).AsDouble(),
+				(render_settings_json_map.at("bus_label_offset"sv).AsArray()[1]).AsDouble()
 			};
 
 			result.stop_label_font_size = render_settings_json_map.at("stop_label_font_size").AsInt();
 			result.stop_label_offset =
 			{
-				(render_settings_json_map.at("stop_label_offset"s).AsArray()[0]).AsDouble(),
-				(render_settings_json_map.at("stop_label_offset"s).AsArray()[1]).AsDouble()
+				(render_settings_json_map.at("stop_label_offset"sv).AsArray()[0]).AsDouble(),
+				(render_settings_json_map.at("stop_label_offset"sv).AsArray()[1]).AsDouble()
 			};
 
 
-			json::Node underlayer_color_node = render_settings_json_map.at("underlayer_color"s);
+			const json::Node& underlayer_color_node = render_settings_json_map.at("underlayer_color"sv);
 			if (underlayer_color_node.IsString()) {
 				result.underlayer_color = svg::Color(underlayer_color_node.AsString());
 			}
@@ -296,9 +584,12 @@ namespace transport_catalogue {
 				}
 			}
 
-			result.underlayer_width = render_settings_json_map.at("underlayer_width"s).AsDouble();
+			result.underlayer_width = render_settings_json_map.at("underlayer_width"sv).AsDouble();
+			if (const auto it = render_settings_json_map.find("simplify_tolerance"sv); it != render_settings_json_map.end()) {
+				result.simplify_tolerance = it->second.AsDouble();
+			}
 
-			for (const json::Node& color_node : render_settings_json_map.at("color_palette"s).AsArray()) {
+			for (const json::Node& color_node : render_settings_json_map.at("color_palette"sv).AsArray()) {
 				if (color_node.IsString()) {
 					result.color_palette.push_back(color_node.AsString());
 				}
@@ -317,9 +608,9 @@ namespace transport_catalogue {
 		
 		//------------------- Routing settings processing -----------------------//
 		RoutingSettings JsonReader::GetRoutingSettings() const {
-			json::Dict routing_settings_map = json_document_.GetRoot().AsMap().at("routing_settings"s).AsMap();
-			int bus_wait_time = routing_settings_map.at("bus_wait_time"s).AsInt();
-			int bus_velocity = routing_settings_map.at("bus_velocity"s).AsInt();
+			const json::Dict& routing_settings_map = json_document_.GetRoot().AsMap().at("routing_settings"sv).AsMap();
+			int bus_wait_time = routing_settings_map.at("bus_wait_time"sv).AsInt();
+			int bus_velocity = routing_settings_map.at("bus_velocity"sv).AsInt();
 			return { bus_wait_time, bus_velocity };
 		}
 
@@ -328,5 +619,18 @@ namespace transport_catalogue {
 			return json_document_.GetRoot().AsMap().at("serialization_settings").AsMap().at("file").AsString();
 		}
 
+		SerializationSettings JsonReader::GetSerializationSettings() const {
+			const json::Dict& settings_map = json_document_.GetRoot().AsMap().at("serialization_settings"sv).AsMap();
+			SerializationSettings result;
+			result.file = settings_map.at("file"sv).AsString();
+			if (const auto it = settings_map.find("prerender_map"sv); it != settings_map.end()) {
+				result.prerender_map = it->second.AsBool();
+			}
+			if (const auto it = settings_map.find("router_table"sv); it != settings_map.end()) {
+				result.router_table = it->second.AsString();
+			}
+			return result;
+		}
+
 	} // namespace json_handler
 } // namespace transport_catalogue
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
 #include "json.h"
 #include "json_builder.h"
+#include "json_writer.h"
 #include "transport_catalogue.h"
 #include "domain.h"
 #include "map_renderer.h"
+#include "request_scheduler.h"
 #include "router.h"
+#include "thread_pool.h"
 
 #include <vector>
 #include <string>
@@ -18,6 +21,27 @@ namespace transport_catalogue {
 			bool is_roundtrip;
 		};
 
+		// Queues of the request scheduler, one per request type
+		enum class RequestType : size_t {
+			STOP,
+			BUS,
+			ROUTE,
+			MAP,
+			// Unknown types and malformed requests
+			OTHER,
+			COUNT
+		};
+
+		RequestType GetRequestType(const json::Node& request);
+		// Throws std::invalid_argument naming the field if a stat request lacks one it is
+		// answered from, or has it of the wrong type. Requests of unknown type pass, as they
+		// get no response anyway
+		void CheckStatRequest(const json::Node& request);
+		// Expected costs and limits of the request types for a scheduler of thread_count
+		// threads (0 for one per hardware thread): Map requests get at most half of them,
+		// so lookups are never left without one
+		std::vector<concurrency::RequestScheduler::ClassSettings> MakeRequestClasses(size_t thread_count);
+
 		class JsonReader {
 		public:
 			using Router = graph::Router<double>;
@@ -27,11 +51,35 @@ namespace transport_catalogue {
 			{}
 
 			void LoadJSON(std::istream& input);
+			// Fills the catalogue, builds the graph and freezes the catalogue
 			void ProcessBaseRequests();
-			void ProcessStatRequests(std::ostream& output) const;
+			// Fills the catalogue exactly as the serial version does. The requests are read and
+			// their stop names looked up on the pool, then added in request order; the graph is
+			// built on the pool too
+			void ProcessBaseRequests(concurrency::WorkStealingPool& pool);
+			// Only the first part: stops, distances, buses and settings, leaving the graph to build
+			void AddBaseRequests();
+			void AddBaseRequests(concurrency::WorkStealingPool& pool);
+			void ProcessStatRequests(std::ostream& output,
+				json::Writer::Format format = json::Writer::Format::PRETTY) const;
+			// Answers requests other than the loaded stat_requests, with a router built earlier;
+			// safe to call from several threads at once
+			void ProcessStatRequests(const json::Array& requests, const Router& router, std::ostream& output,
+				json::Writer::Format format = json::Writer::Format::PRETTY) const;
+			// Same output, with the requests spread over the pool. Every response is rendered into
+			// its own slot and the slots are written out in request order
+			void ProcessStatRequests(std::ostream& output, concurrency::WorkStealingPool& pool,
+				json::Writer::Format format = json::Writer::Format::PRETTY) const;
+			// Same output, with every request queued on the scheduler by its type, so that cheap
+			// requests are answered first
+			void ProcessStatRequests(std::ostream& output, concurrency::RequestScheduler& scheduler,
+				json::Writer::Format format = json::Writer::Format::PRETTY) const;
+			// Writes the response to a single stat request; safe to call from several threads at once
+			void ProcessStatRequest(const json::Dict& request, const Router& router, json::Writer& writer) const;
 			map_renderer::detail::RenderSettings GetRenderSettings() const;
 			RoutingSettings GetRoutingSettings() const;
 			std::string GetSerializationFilename() const;
+			SerializationSettings GetSerializationSettings() const;
 			TransportCatalogue& GetCatalogue() {return catalogue_;}
 
 		private:
@@ -44,11 +92,10 @@ namespace transport_catalogue {
 			void ParseBus(const json::Node& bus_node);
 
 			//---------------- Stat requests processing ----------------//
-			json::Dict ProcessStopStatRequest(const json::Node& stop_node) const;
-			json::Dict ProcessBusStatRequest(const json::Node& bus_node) const;
-			json::Dict ProcessMapStatRequest(const json::Node& map_node) const;
-			json::Dict ProcessRouteStatRequest(const json::Node& route_node, const Router& router) const;
-			std::pair<int, double> ComputeRouteLength(const Bus& bus) const;
+			void ProcessStopStatRequest(const json::Dict& request, json::Writer& writer) const;
+			void ProcessBusStatRequest(const json::Dict& request, json::Writer& writer) const;
+			void ProcessMapStatRequest(const json::Dict& request, json::Writer& writer) const;
+			void ProcessRouteStatRequest(const json::Dict& request, const Router& router, json::Writer& writer) const;
 		};
 
 	} // namespace json_handler
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace json {
+    namespace detail {
+
+        inline bool IsStringSpecial(char c) {
+            return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+        }
+
+        // Returns the first '"', '\\' or control byte (< 0x20) in [begin, end), or end.
+        // Both the parser and the escaping printers only stop on these bytes, so long
+        // runs of plain text are skipped 32 (AVX2) or 16 (SSE2) bytes at a time
+        inline const char* FindStringSpecial(const char* begin, const char* end) {
+#if defined(__AVX2__)
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i max_control = _mm256_set1_epi8(0x1F);
+            for (; end - begin >= 32; begin += 32) {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                const __m256i specials = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+                    // chunk <= 0x1F as unsigned bytes
+                    _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, max_control), max_control));
+                if (const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(specials))) {
+                    return begin + __builtin_ctz(mask);
+                }
+            }
+#elif defined(__SSE2__)
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i max_control = _mm_set1_epi8(0x1F);
+            for (; end - begin >= 16; begin += 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                const __m128i specials = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                    // chunk <= 0x1F as unsigned bytes
+                    _mm_cmpeq_epi8(_mm_max_epu8(chunk, max_control), max_control));
+                if (const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(specials))) {
+                    return begin + __builtin_ctz(mask);
+                }
+            }
+#endif
+            // Portable fallback and the tail shorter than one vector
+            for (; begin != end; ++begin) {
+                if (IsStringSpecial(*begin)) {
+                    return begin;
+                }
+            }
+            return end;
+        }
+
+        // Calls write(std::string_view) with the JSON-escaped contents of value, piece by piece.
+        // Quotes, backslashes, \r and \n are escaped, other control characters go out as is
+        template <typename Write>
+        void WriteEscaped(std::string_view value, Write&& write) {
+            using namespace std::literals;
+
+            const char* pos = value.data();
+            const char* const end = pos + value.size();
+            while (true) {
+                const char* special = FindStringSpecial(pos, end);
+                if (special != pos) {
+                    write(std::string_view(pos, special - pos));
+                }
+                if (special == end) {
+                    return;
+                }
+                switch (*special) {
+                case '\r':
+                    write("\\r"sv);
+                    break;
+                case '\n':
+                    write("\\n"sv);
+                    break;
+                case '"':
+                    write("\\\""sv);
+                    break;
+                case '\\':
+                    write("\\\\"sv);
+                    break;
+                default:
+                    write(std::string_view(special, 1));
+                    break;
+                }
+                pos = special + 1;
+            }
+        }
+
+    } // namespace detail
+} // namespace json
@@ -0,0 +1,294 @@
+#include "json_writer.h"
+#include "json_scanner.h"
+
+#include <array>
+#include <stdexcept>
+#include <variant>
+
+namespace json {
+	using namespace std::literals;
+
+	namespace {
+		constexpr size_t INDENT_STEP = 4;
+
+		std::chars_format GetFloatFormat(const std::ios_base& output) {
+			const auto floatfield = output.flags() & std::ios_base::floatfield;
+			if (floatfield == std::ios_base::fixed) {
+				return std::chars_format::fixed;
+			}
+			if (floatfield == std::ios_base::scientific) {
+				return std::chars_format::scientific;
+			}
+			if (floatfield == (std::ios_base::fixed | std::ios_base::scientific)) {
+				return std::chars_format::hex;
+			}
+			return std::chars_format::general;
+		}
+	} // namespace
+
+	Writer::Writer(std::ostream& output, Format format, size_t buffer_size)
+		: output_(&output)
+		, format_(format)
+		, buffer_size_(buffer_size)
+		, float_format_(GetFloatFormat(output))
+		, float_precision_(static_cast<int>(output.precision()))
+		, buffer_(own_buffer_)
+	{
+		buffer_.reserve(buffer_size_ + buffer_size_ / 8);
+	}
+
+	Writer::Writer(std::string& output, const std::ios_base& number_format, Format format)
+		: output_(nullptr)
+		, format_(format)
+		, buffer_size_(0)
+		, float_format_(GetFloatFormat(number_format))
+		, float_precision_(static_cast<int>(number_format.precision()))
+		, buffer_(output)
+	{}
+
+	Writer::~Writer() {
+		Flush();
+	}
+
+	void Writer::Flush() {
+		if (output_ && !buffer_.empty()) {
+			output_->write(buffer_.data(), buffer_.size());
+			buffer_.clear();
+		}
+	}
+
+	void Writer::FlushIfFull() {
+		if (output_ && buffer_.size() >= buffer_size_) {
+			Flush();
+		}
+	}
+
+	void Writer::WriteIndent(size_t depth) {
+		buffer_.append((base_depth_ + depth) * INDENT_STEP, ' ');
+	}
+
+	Writer& Writer::SetDepth(size_t depth) {
+		base_depth_ = depth;
+		return *this;
+	}
+
+	Writer& Writer::RawValue(std::string_view json_text) {
+		BeforeValue();
+		buffer_ += json_text;
+		FlushIfFull();
+		return *this;
+	}
+
+	void Writer::BeforeValue() {
+		if (in_string_) {
+			throw std::logic_error("Value inside an unfinished string");
+		}
+		if (after_key_) {
+			after_key_ = false;
+			return;
+		}
+		if (levels_.empty()) {
+			return;
+		}
+		Level& level = levels_.back();
+		if (level.is_dict) {
+			throw std::logic_error("Value inside a dict must follow a key");
+		}
+		if (!level.is_empty) {
+			buffer_ += format_ == Format::PRETTY ? ",\n"sv : ","sv;
+		}
+		level.is_empty = false;
+		if (format_ == Format::PRETTY) {
+			WriteIndent(levels_.size());
+		}
+	}
+
+	Writer& Writer::StartArray() {
+		BeforeValue();
+		buffer_ += format_ == Format::PRETTY ? "[\n"sv : "["sv;
+		levels_.push_back({ false, true });
+		return *this;
+	}
+
+	Writer& Writer::EndArray() {
+		if (levels_.empty() || levels_.back().is_dict) {
+			throw std::logic_error("Array ending error");
+		}
+		levels_.pop_back();
+		if (format_ == Format::PRETTY) {
+			buffer_ += '\n';
+			WriteIndent(levels_.size());
+		}
+		buffer_ += ']';
+		FlushIfFull();
+		return *this;
+	}
+
+	Writer& Writer::StartDict() {
+		BeforeValue();
+		buffer_ += format_ == Format::PRETTY ? "{\n"sv : "{"sv;
+		levels_.push_back({ true, true });
+		return *this;
+	}
+
+	Writer& Writer::EndDict() {
+		if (levels_.empty() || !levels_.back().is_dict || after_key_) {
+			throw std::logic_error("Dict ending error");
+		}
+		levels_.pop_back();
+		if (format_ == Format::PRETTY) {
+			buffer_ += '\n';
+			WriteIndent(levels_.size());
+		}
+		buffer_ += '}';
+		FlushIfFull();
+		return *this;
+	}
+
+	Writer& Writer::Key(std::string_view key) {
+		if (levels_.empty() || !levels_.back().is_dict || after_key_ || in_string_) {
+			throw std::logic_error("Can't call key outside the Dict"s);
+		}
+		Level& level = levels_.back();
+		if (format_ == Format::PRETTY) {
+			if (!level.is_empty) {
+				buffer_ += ",\n"sv;
+			}
+			WriteIndent(levels_.size());
+			WriteEscaped(key);
+			buffer_ += ": "sv;
+		}
+		else {
+			if (!level.is_empty) {
+				buffer_ += ',';
+			}
+			WriteEscaped(key);
+			buffer_ += ':';
+		}
+		level.is_empty = false;
+		after_key_ = true;
+		return *this;
+	}
+
+	Writer& Writer::Value(std::nullptr_t) {
+		BeforeValue();
+		buffer_ += "null"sv;
+		return *this;
+	}
+
+	Writer& Writer::Value(bool value) {
+		BeforeValue();
+		buffer_ += value ? "true"sv : "false"sv;
+		return *this;
+	}
+
+	Writer& Writer::Value(int value) {
+		BeforeValue();
+		std::array<char, 16> chars;
+		auto [end, ec] = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+		buffer_.append(chars.data(), end);
+		return *this;
+	}
+
+	Writer& Writer::Value(uint64_t value) {
+		BeforeValue();
+		std::array<char, 24> chars;
+		auto [end, ec] = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+		buffer_.append(chars.data(), end);
+		return *this;
+	}
+
+	Writer& Writer::Value(double value) {
+		BeforeValue();
+		// Large enough for any fixed-notation double with the usual precisions
+		std::array<char, 512> chars;
+		auto [end, ec] = std::to_chars(chars.data(), chars.data() + chars.size(),
+			value, float_format_, float_precision_);
+		if (ec != std::errc()) {
+			throw std::logic_error("Failed to format a number");
+		}
+		buffer_.append(chars.data(), end);
+		return *this;
+	}
+
+	Writer& Writer::Value(std::string_view value) {
+		BeforeValue();
+		WriteEscaped(value);
+		FlushIfFull();
+		return *this;
+	}
+
+	Writer& Writer::Value(const char* value) {
+		return Value(std::string_view(value));
+	}
+
+	Writer& Writer::Value(const std::string& value) {
+		return Value(std::string_view(value));
+	}
+
+	Writer& Writer::Value(const Node& node) {
+		if (node.IsArray()) {
+			StartArray();
+			for (const Node& element : node.AsArray()) {
+				Value(element);
+			}
+			return EndArray();
+		}
+		if (node.IsMap()) {
+			StartDict();
+			for (const auto& [key, value] : node.AsMap()) {
+				Key(key);
+				Value(value);
+			}
+			return EndDict();
+		}
+		std::visit(
+			[this](const auto& value) {
+				using T = std::decay_t<decltype(value)>;
+				if constexpr (!std::is_same_v<T, Array> && !std::is_same_v<T, Dict>) {
+					Value(value);
+				}
+			},
+			node.GetNodeData());
+		return *this;
+	}
+
+	Writer& Writer::StartString() {
+		if (in_string_) {
+			throw std::logic_error("String is already started");
+		}
+		BeforeValue();
+		buffer_ += '"';
+		in_string_ = true;
+		return *this;
+	}
+
+	Writer& Writer::AppendString(std::string_view part) {
+		if (!in_string_) {
+			throw std::logic_error("AppendString outside a string");
+		}
+		detail::WriteEscaped(part, [this](std::string_view escaped) {
+			buffer_ += escaped;
+		});
+		FlushIfFull();
+		return *this;
+	}
+
+	Writer& Writer::EndString() {
+		if (!in_string_) {
+			throw std::logic_error("String ending error");
+		}
+		buffer_ += '"';
+		in_string_ = false;
+		return *this;
+	}
+
+	void Writer::WriteEscaped(std::string_view value) {
+		buffer_ += '"';
+		detail::WriteEscaped(value, [this](std::string_view part) {
+			buffer_ += part;
+		});
+		buffer_ += '"';
+	}
+
+} // namespace json
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "json.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json {
+
+	// Writes JSON straight into a large output buffer, value by value, without building
+	// a Node tree first. The buffer is handed to the stream in a few big write() calls.
+	// PRETTY mode produces exactly the same text as json::Print; numbers follow the
+	// floatfield and precision flags of the output stream, as operator<< would
+	class Writer {
+	public:
+		enum class Format {
+			PRETTY,
+			COMPACT
+		};
+
+		static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+		explicit Writer(std::ostream& output, Format format = Format::PRETTY,
+			size_t buffer_size = DEFAULT_BUFFER_SIZE);
+		// Appends to a string instead of a stream; numbers are formatted the way
+		// number_format would format them
+		Writer(std::string& output, const std::ios_base& number_format, Format format = Format::PRETTY);
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+		~Writer();
+
+		Writer& StartArray();
+		Writer& EndArray();
+		Writer& StartDict();
+		Writer& EndDict();
+		Writer& Key(std::string_view key);
+
+		Writer& Value(std::nullptr_t);
+		Writer& Value(bool value);
+		Writer& Value(int value);
+		// Counts and sizes that may not fit an int. Not in json::Node, so only written
+		Writer& Value(uint64_t value);
+		Writer& Value(double value);
+		Writer& Value(std::string_view value);
+		Writer& Value(const char* value);
+		Writer& Value(const std::string& value);
+		Writer& Value(const Node& node);
+		// Inserts a value that is already serialized, e.g. by another Writer with the same
+		// format and depth, so separately rendered pieces can be spliced into one document
+		Writer& RawValue(std::string_view json_text);
+
+		// A string value written in pieces: each AppendString escapes its piece straight into
+		// the output, so a long text produced on the fly (a rendered map) needs no copy of
+		// its own. Nothing else may be written between StartString and EndString
+		Writer& StartString();
+		Writer& AppendString(std::string_view part);
+		Writer& EndString();
+
+		// Lays out top-level values as if they were nested depth levels deep (PRETTY only)
+		Writer& SetDepth(size_t depth);
+
+		// Hands everything buffered so far to the output stream
+		void Flush();
+
+	private:
+		struct Level {
+			bool is_dict;
+			bool is_empty;
+		};
+
+		void BeforeValue();
+		void WriteIndent(size_t depth);
+		void WriteEscaped(std::string_view value);
+		void FlushIfFull();
+
+		std::ostream* output_;
+		Format format_;
+		size_t buffer_size_;
+		std::chars_format float_format_;
+		int float_precision_;
+		std::string own_buffer_;
+		std::string& buffer_;
+		size_t base_depth_ = 0;
+		std::vector<Level> levels_;
+		bool after_key_ = false;
+		bool in_string_ = false;
+	};
+
+} // namespace json
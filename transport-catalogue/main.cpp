@@ -1,22 +1,208 @@
 #include "transport_catalogue.h"
 // #include "request_handler.h"
+#include "batch_runner.h"
 #include "json_reader.h"
+#include "profile.h"
+#include "router_table.h"
 #include "serialization.h"
+#include "stat_pipeline.h"
+#include "stat_server.h"
 
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <optional>
 #include <string>
 
 using namespace transport_catalogue;
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base [--threads N]|process_requests [--pipelined|--parallel|--scheduled] [--threads N] [--profile PATH]"
+              "|serve SETTINGS_JSON [--reload-dir DIR] [--socket PATH [--workers N] [--max-connections N] [--scheduled [--threads N]]]"
+              "|batch SETTINGS_JSON OUTPUT_DIR INPUT... [--threads N]]\n"sv;
+}
+
+// The thread count make_base is given, 0 for one per hardware thread; nullopt if malformed
+std::optional<size_t> ParseMakeBaseOptions(int argc, const char** argv) {
+	if (argc == 2) {
+		return 0;
+	}
+	if (argc == 4 && argv[2] == "--threads"sv) {
+		try {
+			return std::stoul(argv[3]);
+		}
+		catch (const std::exception&) {
+		}
+	}
+	return std::nullopt;
+}
+
+struct ProcessOptions {
+	bool pipelined = false;
+	bool parallel = false;
+	bool scheduled = false;
+	// 0 means one thread per hardware thread
+	size_t thread_count = 0;
+	// Where to write the profile of the run; empty for none
+	std::string profile_file;
+};
+
+// Options of process_requests; nullopt if they are malformed
+std::optional<ProcessOptions> ParseProcessOptions(int argc, const char** argv) {
+	ProcessOptions options;
+	for (int i = 2; i < argc; ++i) {
+		const std::string_view arg(argv[i]);
+		if (arg == "--pipelined"sv) {
+			options.pipelined = true;
+		}
+		else if (arg == "--parallel"sv) {
+			options.parallel = true;
+		}
+		else if (arg == "--scheduled"sv) {
+			options.scheduled = true;
+		}
+		else if (arg == "--threads"sv && i + 1 < argc) {
+			try {
+				options.thread_count = std::stoul(argv[++i]);
+			}
+			catch (const std::exception&) {
+				return std::nullopt;
+			}
+		}
+		else if (arg == "--profile"sv && i + 1 < argc) {
+			options.profile_file = argv[++i];
+		}
+		else {
+			return std::nullopt;
+		}
+	}
+	if (options.pipelined + options.parallel + options.scheduled > 1) {
+		return std::nullopt;
+	}
+	return options;
+}
+
+struct ServeOptions {
+	// A JSON document with serialization_settings, like the process_requests input
+	std::string settings_file;
+	// Empty means stdin and stdout
+	std::string socket_path;
+	// Where Reload requests may name a base file; empty allows only the loaded one
+	std::string reload_dir;
+	json_handler::SocketSettings socket_settings;
+};
+
+std::optional<ServeOptions> ParseServeOptions(int argc, const char** argv) {
+	if (argc < 3) {
+		return std::nullopt;
+	}
+	ServeOptions options;
+	options.settings_file = argv[2];
+	for (int i = 3; i < argc; ++i) {
+		const std::string_view arg(argv[i]);
+		if (arg == "--socket"sv && i + 1 < argc) {
+			options.socket_path = argv[++i];
+		}
+		else if (arg == "--workers"sv && i + 1 < argc) {
+			try {
+				options.socket_settings.worker_count = std::stoul(argv[++i]);
+			}
+			catch (const std::exception&) {
+				return std::nullopt;
+			}
+		}
+		else if (arg == "--max-connections"sv && i + 1 < argc) {
+			try {
+				options.socket_settings.max_connections = std::stoul(argv[++i]);
+			}
+			catch (const std::exception&) {
+				return std::nullopt;
+			}
+		}
+		else if (arg == "--scheduled"sv) {
+			options.socket_settings.scheduled = true;
+		}
+		else if (arg == "--reload-dir"sv && i + 1 < argc) {
+			options.reload_dir = argv[++i];
+		}
+		else if (arg == "--threads"sv && i + 1 < argc) {
+			try {
+				options.socket_settings.thread_count = std::stoul(argv[++i]);
+			}
+			catch (const std::exception&) {
+				return std::nullopt;
+			}
+		}
+		else {
+			return std::nullopt;
+		}
+	}
+	const json_handler::SocketSettings& socket_settings = options.socket_settings;
+	if ((socket_settings.worker_count > 0 || socket_settings.scheduled || socket_settings.thread_count > 0
+		|| socket_settings.max_connections != json_handler::SocketSettings{}.max_connections)
+		&& options.socket_path.empty()) {
+		return std::nullopt;
+	}
+	return options;
+}
+
+// Options of batch; INPUT is a request file or a directory of them
+std::optional<json_handler::BatchSettings> ParseBatchOptions(int argc, const char** argv) {
+	if (argc < 5) {
+		return std::nullopt;
+	}
+	json_handler::BatchSettings settings;
+	settings.output_dir = argv[3];
+	for (int i = 4; i < argc; ++i) {
+		const std::string_view arg(argv[i]);
+		if (arg == "--threads"sv && i + 1 < argc) {
+			try {
+				settings.thread_count = std::stoul(argv[++i]);
+			}
+			catch (const std::exception&) {
+				return std::nullopt;
+			}
+		}
+		else {
+			settings.inputs.emplace_back(arg);
+		}
+	}
+	if (settings.inputs.empty()) {
+		return std::nullopt;
+	}
+	return settings;
+}
+
+// serialization_settings of a JSON document like the process_requests input
+std::optional<SerializationSettings> ReadSerializationSettings(const std::string& settings_file) {
+	std::ifstream settings_input(settings_file);
+	if (!settings_input) {
+		std::cerr << "Cannot open "sv << settings_file << '\n';
+		return std::nullopt;
+	}
+	transport_catalogue::TransportCatalogue settings_holder;
+	json_handler::JsonReader settings_reader(settings_holder);
+	settings_reader.LoadJSON(settings_input);
+	return settings_reader.GetSerializationSettings();
+}
+
+// Writes the profile of the run, if one was asked for; false if the file cannot be written
+bool WriteProfile(const std::string& profile_file) {
+	if (profile_file.empty()) {
+		return true;
+	}
+	std::ofstream output(profile_file);
+	profile::WriteReport(output);
+	if (!output) {
+		std::cerr << "Cannot write the profile to "sv << profile_file << '\n';
+		return false;
+	}
+	return true;
 }
 
 int main(int argc, const char** argv) {
-	if (argc != 2) {
+	if (argc < 2) {
         PrintUsage();
         return 1;
     }
@@ -24,31 +210,118 @@ int main(int argc, const char** argv) {
 	const std::string_view mode(argv[1]);
 
 	if (mode == "make_base"s) {
+		const std::optional<size_t> thread_count = ParseMakeBaseOptions(argc, argv);
+		if (!thread_count) {
+			PrintUsage();
+			return 1;
+		}
+		concurrency::WorkStealingPool pool(*thread_count);
 		transport_catalogue::TransportCatalogue catalogue;
 		// request_handler::RequestHandler request_handler(catalogue);
 		json_handler::JsonReader json_reader(catalogue);
-		std::ifstream input("/home/eugene/ya_pract/cpp/cpp-transport-catalogue/tests/s14_3_opentest_3_make_base.json");
-		json_reader.LoadJSON(input);
-		json_reader.ProcessBaseRequests();
+		json_reader.LoadJSON(std::cin);
+		json_reader.ProcessBaseRequests(pool);
 		// request_handler.LoadJsonDocument(input);
 		// request_handler.LoadJsonDataIntoCatalogue();
 		const size_t vertex_count = catalogue.GetGraphConstRef().GetVertexCount();
-		std::string filename = json_reader.GetSerializationFilename();
-		Serialize(catalogue, filename);
+		const SerializationSettings settings = json_reader.GetSerializationSettings();
+		if (settings.prerender_map) {
+			catalogue.GetRenderedMap(&pool);
+		}
+		Serialize(catalogue, settings.file, settings.prerender_map, &pool);
+		if (!settings.router_table.empty()) {
+			const graph::Router<double> router(catalogue.GetGraphConstRef(), pool);
+			graph::SaveRouterTable(router, catalogue.GetGraphConstRef(), settings.router_table);
+		}
 	}
 	else if (mode == "process_requests"s) {
+		const std::optional<ProcessOptions> options = ParseProcessOptions(argc, argv);
+		if (!options) {
+			PrintUsage();
+			return 1;
+		}
+		if (!options->profile_file.empty()) {
+			if (!profile::IsBuiltIn()) {
+				std::cerr << "--profile needs a build with TRANSPORT_CATALOGUE_PROFILING\n"sv;
+				return 1;
+			}
+			profile::Enable();
+		}
+		std::ostream& output = std::cout;
+		output << std::setprecision(6) << std::fixed;
+		if (options->pipelined) {
+			json_handler::PipelineSettings settings;
+			settings.worker_count = options->thread_count;
+			std::cin.tie(nullptr);
+			json_handler::ProcessRequestsPipelined(std::cin, output, settings);
+			return WriteProfile(options->profile_file) ? 0 : 1;
+		}
+
 		transport_catalogue::TransportCatalogue catalogue;
 		json_handler::JsonReader json_reader(catalogue);
-		std::ifstream input("/home/eugene/ya_pract/cpp/cpp-transport-catalogue/tests/s14_3_opentest_3_process_requests.json");
-		json_reader.LoadJSON(input);
+		json_reader.LoadJSON(std::cin);
 
 		std::string filename = json_reader.GetSerializationFilename();
 		Deserialize(filename, catalogue);
 
-		std::ofstream output("/home/eugene/ya_pract/cpp/cpp-transport-catalogue/test_answers/1.json");
-		output << std::setprecision(6) << std::fixed;
 		const size_t vertex_count = catalogue.GetGraphConstRef().GetVertexCount();
-		json_reader.ProcessStatRequests(output);
+		if (options->parallel) {
+			concurrency::WorkStealingPool pool(options->thread_count);
+			json_reader.ProcessStatRequests(output, pool);
+		}
+		else if (options->scheduled) {
+			concurrency::RequestScheduler scheduler(json_handler::MakeRequestClasses(options->thread_count),
+				options->thread_count);
+			json_reader.ProcessStatRequests(output, scheduler);
+		}
+		else {
+			json_reader.ProcessStatRequests(output);
+		}
+		if (!WriteProfile(options->profile_file)) {
+			return 1;
+		}
+	}
+	else if (mode == "serve"s) {
+		const std::optional<ServeOptions> options = ParseServeOptions(argc, argv);
+		if (!options) {
+			PrintUsage();
+			return 1;
+		}
+		const std::optional<SerializationSettings> settings = ReadSerializationSettings(options->settings_file);
+		if (!settings) {
+			return 1;
+		}
+		const json_handler::StatServer server(settings->file, settings->router_table, options->reload_dir);
+		if (options->socket_path.empty()) {
+			server.ServeStream(std::cin, std::cout);
+		}
+		else {
+			server.ServeSocket(options->socket_path, options->socket_settings);
+		}
+	}
+	else if (mode == "batch"s) {
+		const std::optional<json_handler::BatchSettings> batch_settings = ParseBatchOptions(argc, argv);
+		if (!batch_settings) {
+			PrintUsage();
+			return 1;
+		}
+		// Errors of single files are reported by RunBatch; these are the ones that stop it all:
+		// malformed settings, an unreadable base, clashing output names, an output directory
+		// that cannot be made
+		try {
+			const std::optional<SerializationSettings> settings = ReadSerializationSettings(argv[2]);
+			if (!settings) {
+				return 1;
+			}
+			const json_handler::BaseSnapshot base(settings->file, settings->router_table);
+			if (json_handler::RunBatch(base, *batch_settings, std::cerr) > 0) {
+				return 1;
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << '\n';
+			return 1;
+		}
 	}
 	else {
 		PrintUsage();
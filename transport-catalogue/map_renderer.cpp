@@ -1,4 +1,9 @@
 #include "map_renderer.h"
+#include "catalogue_view.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 
 using namespace std::literals;
 
@@ -8,137 +13,421 @@ namespace map_renderer {
 			return std::abs(value) < EPSILON;
 		}
 
+		namespace {
+			double DistanceToSegment(svg::Point point, svg::Point from, svg::Point to) {
+				const double dx = to.x - from.x;
+				const double dy = to.y - from.y;
+				const double length_sq = dx * dx + dy * dy;
+				double t = 0.0;
+				if (length_sq > 0.0) {
+					t = std::clamp(((point.x - from.x) * dx + (point.y - from.y) * dy) / length_sq, 0.0, 1.0);
+				}
+				return std::hypot(point.x - (from.x + t * dx), point.y - (from.y + t * dy));
+			}
+		}
+
+		std::vector<uint32_t> SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance) {
+			if (points.size() < 3) {
+				std::vector<uint32_t> all(points.size());
+				std::iota(all.begin(), all.end(), 0);
+				return all;
+			}
+			std::vector<bool> keep(points.size(), false);
+			keep.front() = true;
+			keep.back() = true;
+			// Spans still to be checked; an explicit stack keeps long lines off the call stack
+			std::vector<std::pair<size_t, size_t>> spans{ { 0, points.size() - 1 } };
+			while (!spans.empty()) {
+				const auto [first, last] = spans.back();
+				spans.pop_back();
+				double max_distance = 0.0;
+				size_t farthest = first;
+				for (size_t i = first + 1; i < last; ++i) {
+					const double distance = DistanceToSegment(points[i], points[first], points[last]);
+					if (distance > max_distance) {
+						max_distance = distance;
+						farthest = i;
+					}
+				}
+				if (max_distance > tolerance) {
+					keep[farthest] = true;
+					spans.push_back({ first, farthest });
+					spans.push_back({ farthest, last });
+				}
+			}
+			std::vector<uint32_t> result;
+			for (uint32_t i = 0; i < points.size(); ++i) {
+				if (keep[i]) {
+					result.push_back(i);
+				}
+			}
+			return result;
+		}
+
 	}
 
 	MapRenderer::MapRenderer(const detail::RenderSettings& render_settings,
-		const BusNameToBusMap& busname_to_bus_map)
+		const transport_catalogue::CatalogueView& catalogue)
 		: settings_(render_settings)
-		, busname_to_bus_map_(busname_to_bus_map)
-	{}
-
-	StopNameToStopMap MapRenderer::CreateUniqueStopsMap() const {
-		StopNameToStopMap result;
-		for (const auto& [bus_name, bus_ptr] : busname_to_bus_map_) {
-			for (const transport_catalogue::Stop* stop : bus_ptr->stops) {
-				result.insert({ stop->name, stop });
+	{
+		for (const transport_catalogue::Bus* bus_ptr : catalogue.GetBusesByName()) {
+			if (!bus_ptr->stops.empty()) {
+				buses_.push_back(bus_ptr);
 			}
+			stops_.insert(stops_.end(), bus_ptr->stops.begin(), bus_ptr->stops.end());
 		}
-		return result;
+		// Stop names are unique, so equal names mean the same stop
+		std::sort(stops_.begin(), stops_.end(), [](const auto* lhs, const auto* rhs) {
+			return lhs->name < rhs->name;
+		});
+		stops_.erase(std::unique(stops_.begin(), stops_.end()), stops_.end());
+
+		all_buses_.resize(buses_.size());
+		std::iota(all_buses_.begin(), all_buses_.end(), 0);
+		all_stops_.resize(stops_.size());
+		std::iota(all_stops_.begin(), all_stops_.end(), 0);
 	}
 
 	void MapRenderer::SetScalingSettings(std::vector<geo::Coordinates>&& coordinates_to_scale) {
 		projector_ = detail::SphereProjector(coordinates_to_scale.begin(), coordinates_to_scale.end(),
 			settings_.width, settings_.height, settings_.padding
 		);
+
+		size_t max_stop_id = 0;
+		for (const transport_catalogue::Stop* stop : stops_) {
+			max_stop_id = std::max(max_stop_id, stop->id);
+		}
+		stop_points_.assign(stops_.empty() ? 0 : max_stop_id + 1, svg::Point());
+		for (const transport_catalogue::Stop* stop : stops_) {
+			stop_points_[stop->id] = projector_(stop->coords);
+		}
+		PrepareStopPoints();
 	}
 
-	void MapRenderer::RenderPolyline(svg::Document& document) const {
-		int color_selector = -1;
-		for (const auto& [bus_name, bus_ptr] : busname_to_bus_map_) {
-			if (!(bus_ptr->stops).empty()) {
-				color_selector++;
+	void MapRenderer::SetStopPoints(std::vector<svg::Point> stop_points) {
+		stop_points_ = std::move(stop_points);
+		PrepareStopPoints();
+	}
+
+	void MapRenderer::PrepareStopPoints() {
+		std::vector<GridIndex::Segment> stop_segments;
+		stop_segments.reserve(stops_.size());
+		for (uint32_t i = 0; i < stops_.size(); ++i) {
+			const svg::Point point = StopPoint(stops_[i]);
+			stop_segments.push_back({ point, point, i });
+		}
+		stop_index_ = GridIndex(std::move(stop_segments));
+
+		// The way back of a linear route runs over the same segments
+		std::vector<GridIndex::Segment> bus_segments;
+		for (uint32_t i = 0; i < buses_.size(); ++i) {
+			const std::vector<const transport_catalogue::Stop*>& stops = buses_[i]->stops;
+			if (stops.size() == 1) {
+				bus_segments.push_back({ StopPoint(stops[0]), StopPoint(stops[0]), i });
 			}
-			else {
-				continue;
-			}
-			svg::Polyline polyline;
-			polyline.SetFillColor("none"s)
-				.SetStrokeColor(settings_.color_palette[color_selector % settings_.color_palette.size()])
-				.SetStrokeWidth(settings_.line_width)
-				.SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-				.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-			for (int i = 0; i < (bus_ptr->stops).size(); i++) {
-				const transport_catalogue::Stop* stop = bus_ptr->stops[i];
-				polyline.AddPoint(projector_(stop->coords));
-			}
-			if (!bus_ptr->is_roundtrip) {
-				for (int i = bus_ptr->stops.size() - 2; i >= 0; i--) {
-					const transport_catalogue::Stop* stop = bus_ptr->stops[i];
-					polyline.AddPoint(projector_(stop->coords));
+			for (size_t j = 1; j < stops.size(); ++j) {
+				bus_segments.push_back({ StopPoint(stops[j - 1]), StopPoint(stops[j]), i });
+			}
+		}
+		bus_index_ = GridIndex(std::move(bus_segments));
+
+		if (settings_.simplify_tolerance > 0 && simplified_polylines_.empty()) {
+			size_t max_bus_id = 0;
+			for (const transport_catalogue::Bus* bus : buses_) {
+				max_bus_id = std::max(max_bus_id, bus->id);
+			}
+			simplified_polylines_.resize(buses_.empty() ? 0 : max_bus_id + 1);
+			std::vector<svg::Point> points;
+			for (const transport_catalogue::Bus* bus : buses_) {
+				points.clear();
+				for (const transport_catalogue::Stop* stop : bus->stops) {
+					points.push_back(StopPoint(stop));
 				}
+				simplified_polylines_[bus->id] = detail::SimplifyPolyline(points, settings_.simplify_tolerance);
 			}
-			document.Add(polyline);
 		}
 	}
 
-	void MapRenderer::RenderText(svg::Document& document) const {
-		int color_selector = -1;
-		for (const auto& [bus_name, bus_ptr] : busname_to_bus_map_) {
-			if (!(bus_ptr->stops).empty()) {
-				color_selector++;
+	void MapRenderer::SetSimplifiedPolylines(std::vector<std::vector<uint32_t>> kept_stops) {
+		simplified_polylines_ = std::move(kept_stops);
+	}
+
+	namespace {
+		const svg::Color STOP_SYMBOL_COLOR{ "white"s };
+		const svg::Color STOP_NAME_COLOR{ "black"s };
+
+		// Lets the map layers fill an svg::Document through the svg::Writer interface
+		class DocumentCanvas {
+		public:
+			explicit DocumentCanvas(svg::Document& document)
+				: document_(document)
+			{}
+
+			void Circle(svg::Point center, double radius, const svg::PathAttrs& attrs) {
+				svg::Circle circle;
+				circle.SetCenter(center).SetRadius(radius);
+				ApplyAttrs(circle, attrs);
+				document_.Add(std::move(circle));
+			}
+
+			void StartPolyline() {
+				polyline_ = svg::Polyline();
+			}
+
+			void AddPoint(svg::Point point) {
+				polyline_.AddPoint(point);
+			}
+
+			void EndPolyline(const svg::PathAttrs& attrs) {
+				ApplyAttrs(polyline_, attrs);
+				document_.Add(std::move(polyline_));
+			}
+
+			void Text(const svg::TextAttrs& text_attrs, const svg::PathAttrs& attrs) {
+				svg::Text text;
+				text.SetPosition(text_attrs.position)
+					.SetOffset(text_attrs.offset)
+					.SetFontSize(text_attrs.font_size)
+					.SetFontFamily(std::string(text_attrs.font_family))
+					.SetFontWeight(std::string(text_attrs.font_weight))
+					.SetData(std::string(text_attrs.data));
+				ApplyAttrs(text, attrs);
+				document_.Add(std::move(text));
+			}
+
+		private:
+			template <typename Owner>
+			static void ApplyAttrs(svg::PathProps<Owner>& object, const svg::PathAttrs& attrs) {
+				if (attrs.fill_color) {
+					object.SetFillColor(*attrs.fill_color);
+				}
+				if (attrs.stroke_color) {
+					object.SetStrokeColor(*attrs.stroke_color);
+				}
+				if (attrs.stroke_width) {
+					object.SetStrokeWidth(*attrs.stroke_width);
+				}
+				if (attrs.line_cap) {
+					object.SetStrokeLineCap(*attrs.line_cap);
+				}
+				if (attrs.line_join) {
+					object.SetStrokeLineJoin(*attrs.line_join);
+				}
+			}
+
+			svg::Document& document_;
+			svg::Polyline polyline_;
+		};
+	}
+
+	template <typename Canvas>
+	void MapRenderer::RenderPolyline(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+		const detail::ViewTransform& view) const {
+		for (; first != last; ++first) {
+			const uint32_t bus_index = *first;
+			const transport_catalogue::Bus* bus_ptr = buses_[bus_index];
+			const std::vector<const transport_catalogue::Stop*>& stops = bus_ptr->stops;
+			svg::PathAttrs attrs;
+			attrs.fill_color = &svg::NoneColor;
+			attrs.stroke_color = &settings_.color_palette[bus_index % settings_.color_palette.size()];
+			attrs.stroke_width = settings_.line_width;
+			attrs.line_cap = svg::StrokeLineCap::ROUND;
+			attrs.line_join = svg::StrokeLineJoin::ROUND;
+
+			canvas.StartPolyline();
+			// The simplification tolerance holds in output pixels only while the view does not zoom in
+			const std::vector<uint32_t>* kept = nullptr;
+			if (view.zoom <= 1.0 && bus_ptr->id < simplified_polylines_.size()
+				&& !simplified_polylines_[bus_ptr->id].empty()) {
+				kept = &simplified_polylines_[bus_ptr->id];
+			}
+			if (kept) {
+				for (uint32_t i : *kept) {
+					canvas.AddPoint(view(StopPoint(stops[i])));
+				}
+				if (!bus_ptr->is_roundtrip) {
+					for (size_t i = kept->size() - 1; i-- > 0;) {
+						canvas.AddPoint(view(StopPoint(stops[(*kept)[i]])));
+					}
+				}
 			}
 			else {
-				continue;
-			}
-
-			svg::Text general;
-			general.SetPosition(projector_(bus_ptr->stops[0]->coords))
-				.SetOffset(settings_.bus_label_offset)
-				.SetFontSize(settings_.bus_label_font_size)
-				.SetFontFamily("Verdana"s)
-				.SetFontWeight("bold"s)
-				.SetData(std::string(bus_name));
-
-			svg::Text substrate_general = general;
-			svg::Text first_stop_substrate = substrate_general.SetFillColor(settings_.underlayer_color)
-				.SetStrokeColor(settings_.underlayer_color)
-				.SetStrokeWidth(settings_.underlayer_width)
-				.SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-				.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-			svg::Text first_stop_text_general = general;
-			svg::Text first_stop_text = first_stop_text_general.SetFillColor(settings_.color_palette[color_selector % settings_.color_palette.size()]);
-			document.Add(first_stop_substrate);
-			document.Add(first_stop_text);
-			if (!(bus_ptr->is_roundtrip) && bus_ptr->stops[0] != bus_ptr->stops[(bus_ptr->stops).size() - 1]) {
-				svg::Text last_stop_substrate = first_stop_substrate.SetPosition(projector_(bus_ptr->stops[bus_ptr->stops.size() - 1]->coords));
-				svg::Text last_stop_text = first_stop_text.SetPosition(projector_(bus_ptr->stops[bus_ptr->stops.size() - 1]->coords));
-				document.Add(last_stop_substrate);
-				document.Add(last_stop_text);
+				for (const transport_catalogue::Stop* stop : stops) {
+					canvas.AddPoint(view(StopPoint(stop)));
+				}
+				if (!bus_ptr->is_roundtrip) {
+					for (size_t i = stops.size() - 1; i-- > 0;) {
+						canvas.AddPoint(view(StopPoint(stops[i])));
+					}
+				}
+			}
+			canvas.EndPolyline(attrs);
+		}
+	}
+
+	template <typename Canvas>
+	void MapRenderer::RenderText(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+		const detail::ViewTransform& view) const {
+		svg::PathAttrs underlayer;
+		underlayer.fill_color = &settings_.underlayer_color;
+		underlayer.stroke_color = &settings_.underlayer_color;
+		underlayer.stroke_width = settings_.underlayer_width;
+		underlayer.line_cap = svg::StrokeLineCap::ROUND;
+		underlayer.line_join = svg::StrokeLineJoin::ROUND;
+
+		for (; first != last; ++first) {
+			const uint32_t bus_index = *first;
+			const transport_catalogue::Bus* bus_ptr = buses_[bus_index];
+			const std::vector<const transport_catalogue::Stop*>& stops = bus_ptr->stops;
+			svg::PathAttrs label;
+			label.fill_color = &settings_.color_palette[bus_index % settings_.color_palette.size()];
+
+			svg::TextAttrs text;
+			text.position = view(StopPoint(stops.front()));
+			text.offset = settings_.bus_label_offset;
+			text.font_size = settings_.bus_label_font_size;
+			text.font_family = "Verdana"sv;
+			text.font_weight = "bold"sv;
+			text.data = bus_ptr->name;
+
+			canvas.Text(text, underlayer);
+			canvas.Text(text, label);
+			if (!bus_ptr->is_roundtrip && stops.front() != stops.back()) {
+				text.position = view(StopPoint(stops.back()));
+				canvas.Text(text, underlayer);
+				canvas.Text(text, label);
 			}
 		}
 	}
 
-	void MapRenderer::RenderStopSymbols(svg::Document& document) const {
-		StopNameToStopMap stopname_to_stop_map = CreateUniqueStopsMap();
-		for (const auto& [stop_name_sv, stop_ptr] : stopname_to_stop_map) {
-			svg::Circle circle;
-			circle.SetCenter(projector_(stop_ptr->coords))
-				.SetRadius(settings_.stop_radius)
-				.SetFillColor("white"s);
-			document.Add(circle);
+	template <typename Canvas>
+	void MapRenderer::RenderStopSymbols(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+		const detail::ViewTransform& view) const {
+		svg::PathAttrs attrs;
+		attrs.fill_color = &STOP_SYMBOL_COLOR;
+		for (; first != last; ++first) {
+			canvas.Circle(view(StopPoint(stops_[*first])), settings_.stop_radius, attrs);
 		}
 	}
 
-	void MapRenderer::RenderStopNames(svg::Document& document) const {
-		StopNameToStopMap stopname_to_stop_map = CreateUniqueStopsMap();
-		for (const auto& [stop_name_sv, stop_ptr] : stopname_to_stop_map) {
-			svg::Text general;
-			general.SetPosition(projector_(stop_ptr->coords))
-				.SetOffset(settings_.stop_label_offset)
-				.SetFontSize(settings_.stop_label_font_size)
-				.SetFontFamily("Verdana"s)
-				.SetData(std::string(stop_name_sv));
-
-			svg::Text substrate_general = general;
-			svg::Text substrate = substrate_general.SetFillColor(settings_.underlayer_color)
-				.SetStrokeColor(settings_.underlayer_color)
-				.SetStrokeWidth(settings_.underlayer_width)
-				.SetStrokeLineCap(svg::StrokeLineCap::ROUND)
-				.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-
-			svg::Text text_general = general;
-			svg::Text text = text_general.SetFillColor("black"s);
-			document.Add(substrate);
-			document.Add(text);
+	template <typename Canvas>
+	void MapRenderer::RenderStopNames(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+		const detail::ViewTransform& view) const {
+		svg::PathAttrs underlayer;
+		underlayer.fill_color = &settings_.underlayer_color;
+		underlayer.stroke_color = &settings_.underlayer_color;
+		underlayer.stroke_width = settings_.underlayer_width;
+		underlayer.line_cap = svg::StrokeLineCap::ROUND;
+		underlayer.line_join = svg::StrokeLineJoin::ROUND;
+
+		svg::PathAttrs label;
+		label.fill_color = &STOP_NAME_COLOR;
+
+		for (; first != last; ++first) {
+			const transport_catalogue::Stop* stop_ptr = stops_[*first];
+			svg::TextAttrs text;
+			text.position = view(StopPoint(stop_ptr));
+			text.offset = settings_.stop_label_offset;
+			text.font_size = settings_.stop_label_font_size;
+			text.font_family = "Verdana"sv;
+			text.data = stop_ptr->name;
+
+			canvas.Text(text, underlayer);
+			canvas.Text(text, label);
+		}
+	}
+
+	template <typename Canvas>
+	void MapRenderer::RenderLayers(Canvas& canvas, const Ids& buses, const Ids& stops,
+		const detail::ViewTransform& view) const {
+		const uint32_t* buses_first = buses.data();
+		const uint32_t* stops_first = stops.data();
+		RenderPolyline(canvas, buses_first, buses_first + buses.size(), view);
+		RenderText(canvas, buses_first, buses_first + buses.size(), view);
+		RenderStopSymbols(canvas, stops_first, stops_first + stops.size(), view);
+		RenderStopNames(canvas, stops_first, stops_first + stops.size(), view);
+	}
+
+	void MapRenderer::RenderMap(svg::Writer& writer) const {
+		writer.StartDocument();
+		RenderLayers(writer, all_buses_, all_stops_, {});
+		writer.EndDocument();
+	}
+
+	void MapRenderer::RenderViewport(svg::Writer& writer, const Viewport& viewport) const {
+		// Lines, circles and labels are drawn at their size in output pixels whatever the
+		// zoom, so the ones of buses and stops just outside the area still reach into it
+		const double reach = std::max(settings_.line_width / 2, settings_.stop_radius)
+			+ std::max({ std::abs(settings_.bus_label_offset.x), std::abs(settings_.bus_label_offset.y),
+				std::abs(settings_.stop_label_offset.x), std::abs(settings_.stop_label_offset.y) })
+			+ std::max(settings_.bus_label_font_size, settings_.stop_label_font_size)
+			+ settings_.underlayer_width / 2;
+		const double margin = reach / viewport.zoom;
+		const Rect query_area{ viewport.area.min_x - margin, viewport.area.min_y - margin,
+			viewport.area.max_x + margin, viewport.area.max_y + margin };
+
+		Ids buses;
+		bus_index_.Query(query_area, buses);
+		std::sort(buses.begin(), buses.end());
+		buses.erase(std::unique(buses.begin(), buses.end()), buses.end());
+
+		Ids stops;
+		stop_index_.Query(query_area, stops);
+		std::sort(stops.begin(), stops.end());
+
+		const detail::ViewTransform view{ { viewport.area.min_x, viewport.area.min_y }, viewport.zoom };
+		writer.StartDocument((viewport.area.max_x - viewport.area.min_x) * viewport.zoom,
+			(viewport.area.max_y - viewport.area.min_y) * viewport.zoom);
+		RenderLayers(writer, buses, stops, view);
+		writer.EndDocument();
+	}
+
+	void MapRenderer::RenderMap(svg::Writer& writer, concurrency::WorkStealingPool& pool) const {
+		// Buses or stops per chunk: enough markup to outweigh scheduling, small enough
+		// to spread a city over all threads
+		constexpr size_t CHUNK_SIZE = 256;
+
+		using Layer = void (MapRenderer::*)(svg::Writer&, const uint32_t*, const uint32_t*,
+			const detail::ViewTransform&) const;
+		const std::pair<Layer, const Ids*> layers[] = {
+			{ &MapRenderer::RenderPolyline<svg::Writer>, &all_buses_ },
+			{ &MapRenderer::RenderText<svg::Writer>, &all_buses_ },
+			{ &MapRenderer::RenderStopSymbols<svg::Writer>, &all_stops_ },
+			{ &MapRenderer::RenderStopNames<svg::Writer>, &all_stops_ },
+		};
+		struct Chunk {
+			Layer layer;
+			const uint32_t* first;
+			const uint32_t* last;
+		};
+		std::vector<Chunk> chunks;
+		for (const auto& [layer, ids] : layers) {
+			for (size_t begin = 0; begin < ids->size(); begin += CHUNK_SIZE) {
+				const size_t end = std::min(begin + CHUNK_SIZE, ids->size());
+				chunks.push_back({ layer, ids->data() + begin, ids->data() + end });
+			}
+		}
+
+		std::vector<std::string> parts(chunks.size());
+		const detail::ViewTransform view;
+		pool.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				svg::Writer part_writer(parts[i]);
+				(this->*chunks[i].layer)(part_writer, chunks[i].first, chunks[i].last, view);
+			}
+		});
+
+		writer.StartDocument();
+		for (const std::string& part : parts) {
+			writer.RawMarkup(part);
 		}
+		writer.EndDocument();
 	}
 
 	svg::Document MapRenderer::RenderMap() const {
 		svg::Document result;
-		RenderPolyline(result);
-		RenderText(result);
-		RenderStopSymbols(result);
-		RenderStopNames(result);
+		DocumentCanvas canvas(result);
+		RenderLayers(canvas, all_buses_, all_stops_, {});
 		return result;
 	}
-}
\ No newline at end of file
+}
@@ -2,12 +2,19 @@
 #include "svg.h"
 #include "geo.h"
 #include "domain.h"
+#include "spatial_index.h"
+#include "thread_pool.h"
 
 #include <vector>
 #include <algorithm>
+#include <cstdint>
 #include <map>
 #include <set>
 
+namespace transport_catalogue {
+    class CatalogueView;
+}
+
 namespace map_renderer {
     namespace detail {
         struct RenderSettings {
@@ -23,8 +30,14 @@ namespace map_renderer {
             svg::Color underlayer_color;
             double underlayer_width;
             std::vector<svg::Color> color_palette;
+            // Largest deviation, in pixels, allowed when bus lines are simplified; 0 keeps every stop
+            double simplify_tolerance = 0;
         };
 
+        // Douglas-Peucker: positions of the points to keep so that no dropped point is
+        // farther than tolerance from the line through the kept ones. Ends are always kept
+        std::vector<uint32_t> SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance);
+
         inline const double EPSILON = 1e-6;
         bool IsZero(double value);
 
@@ -100,25 +113,102 @@ namespace map_renderer {
 
     } // namespace detail
 
+    // Part of the map to render: a rectangle in pixels of the full map, scaled by zoom.
+    // The rectangle's corner becomes the origin of the output
+    struct Viewport {
+        Rect area;
+        double zoom = 1.0;
+    };
+
+    namespace detail {
+        // Moves projected points into viewport coordinates; the default one changes nothing
+        struct ViewTransform {
+            svg::Point origin;
+            double zoom = 1.0;
+
+            svg::Point operator()(svg::Point point) const {
+                return { (point.x - origin.x) * zoom, (point.y - origin.y) * zoom };
+            }
+        };
+    } // namespace detail
+
     using BusNameToBusMap = std::map<std::string_view, const transport_catalogue::Bus*>;
     using StopNameToStopMap = std::map<std::string_view, const transport_catalogue::Stop*>;
     class MapRenderer {
     public:
         MapRenderer(const detail::RenderSettings& render_settings,
-            const BusNameToBusMap& busname_to_bus_map);
+            const transport_catalogue::CatalogueView& catalogue);
+        // Fixes the projection, projects every stop, builds the spatial indexes and, with a
+        // simplify_tolerance, simplifies bus lines that were not given via SetSimplifiedPolylines
         void SetScalingSettings(std::vector<geo::Coordinates>&& coordinates_to_scale);
-        void RenderPolyline(svg::Document& document) const;
-        void RenderText(svg::Document& document) const;
-        void RenderStopSymbols(svg::Document& document) const;
-        void RenderStopNames(svg::Document& document) const;
+        // Same as SetScalingSettings with stops projected earlier, indexed by Stop::id
+        void SetStopPoints(std::vector<svg::Point> stop_points);
+        const std::vector<svg::Point>& GetStopPoints() const {
+            return stop_points_;
+        }
+        // Kept positions in Bus::stops, indexed by Bus::id; an empty entry keeps every stop
+        void SetSimplifiedPolylines(std::vector<std::vector<uint32_t>> kept_stops);
+        const std::vector<std::vector<uint32_t>>& GetSimplifiedPolylines() const {
+            return simplified_polylines_;
+        }
+        // Streams the whole document into writer without building svg objects
+        void RenderMap(svg::Writer& writer) const;
+        // Same document; layers are cut into chunks that the pool renders into separate
+        // buffers, which are then joined in drawing order
+        void RenderMap(svg::Writer& writer, concurrency::WorkStealingPool& pool) const;
         svg::Document RenderMap() const;
+        // Only the buses and stops inside the viewport, found through the spatial indexes,
+        // so the cost follows what is visible rather than the size of the network. Those
+        // whose lines, circles or labels can reach into it from outside are drawn as well;
+        // the document is sized to the viewport, so viewers crop them at its edges
+        void RenderViewport(svg::Writer& writer, const Viewport& viewport) const;
 
     private:
+        using Ids = std::vector<uint32_t>;
+
+        // Everything derived from stop_points_: the spatial indexes and simplified lines
+        void PrepareStopPoints();
+
         detail::RenderSettings settings_;
         detail::SphereProjector projector_;
-        const BusNameToBusMap& busname_to_bus_map_;
-
-        StopNameToStopMap CreateUniqueStopsMap() const;
+        // Buses that have stops, by name; a bus' position here selects its palette color
+        std::vector<const transport_catalogue::Bus*> buses_;
+        // Every stop served by some bus, once, by name
+        std::vector<const transport_catalogue::Stop*> stops_;
+        // Positions in buses_ and stops_ of everything, for full renders
+        Ids all_buses_;
+        Ids all_stops_;
+        // Projected points, indexed by Stop::id
+        std::vector<svg::Point> stop_points_;
+        // See SetSimplifiedPolylines; used while the view does not zoom in
+        std::vector<std::vector<uint32_t>> simplified_polylines_;
+        // Bus segments with their bus' position in buses_ and stop points with the
+        // stop's position in stops_
+        GridIndex bus_index_;
+        GridIndex stop_index_;
+
+        svg::Point StopPoint(const transport_catalogue::Stop* stop) const {
+            return stop_points_[stop->id];
+        }
+
+        // Map layers, in drawing order, each over positions in buses_ or stops_ given in
+        // ascending order. Canvas is svg::Writer or an adapter that fills an svg::Document,
+        // so both outputs come from the same code
+        template <typename Canvas>
+        void RenderPolyline(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+            const detail::ViewTransform& view) const;
+        template <typename Canvas>
+        void RenderText(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+            const detail::ViewTransform& view) const;
+        template <typename Canvas>
+        void RenderStopSymbols(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+            const detail::ViewTransform& view) const;
+        template <typename Canvas>
+        void RenderStopNames(Canvas& canvas, const uint32_t* first, const uint32_t* last,
+            const detail::ViewTransform& view) const;
+        template <typename Canvas>
+        void RenderLayers(Canvas& canvas, const Ids& buses, const Ids& stops,
+            const detail::ViewTransform& view) const;
     };
 
-} // namespace map_renderer
\ No newline at end of file
+} // namespace map_renderer
@@ -0,0 +1,195 @@
+#include "profile.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace profile {
+
+    using namespace std::literals;
+
+    namespace detail {
+        std::atomic<bool> enabled{ false };
+    }
+
+    namespace {
+        constexpr size_t PHASE_COUNT = static_cast<size_t>(Phase::COUNT);
+        constexpr size_t DISTRIBUTION_COUNT = static_cast<size_t>(Distribution::COUNT);
+        constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::COUNT);
+
+        constexpr std::string_view PHASE_NAMES[PHASE_COUNT] = {
+            "parse_json"sv, "deserialize"sv, "build_router"sv, "render_map"sv, "answer_requests"sv
+        };
+        constexpr std::string_view REQUEST_NAMES[] = { "Stop"sv, "Bus"sv, "Route"sv, "Map"sv };
+        constexpr std::string_view COUNTER_NAMES[COUNTER_COUNT] = {
+            "relaxations"sv, "improvements"sv, "routes_found"sv, "routes_not_found"sv
+        };
+
+        struct Profile {
+            std::array<std::atomic<uint64_t>, PHASE_COUNT> phase_time_ns{};
+            std::array<std::atomic<uint64_t>, PHASE_COUNT> phase_entries{};
+            std::array<Histogram, DISTRIBUTION_COUNT> distributions;
+            std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters{};
+        };
+
+        Profile& GetProfile() {
+            static Profile profile;
+            return profile;
+        }
+
+        // Percentiles, then the non-empty buckets as [highest value, count] pairs, from
+        // which any other percentile can be read off. Keys of values end in suffix
+        void WriteHistogram(json::Writer& writer, const Histogram& histogram, std::string_view suffix) {
+            const std::string unit(suffix);
+            const uint64_t count = histogram.GetCount();
+            writer.StartDict().Key("count"sv).Value(count);
+            writer.Key("min"s + unit).Value(histogram.GetMin());
+            writer.Key("mean"s + unit).Value(count > 0 ? histogram.GetSum() / count : 0);
+            for (const auto& [name, percentile] : { std::pair("p50"sv, 50.0), std::pair("p90"sv, 90.0),
+                                                    std::pair("p99"sv, 99.0), std::pair("p99_9"sv, 99.9) }) {
+                writer.Key(std::string(name) + unit).Value(histogram.GetValueAtPercentile(percentile));
+            }
+            writer.Key("max"s + unit).Value(histogram.GetMax());
+            writer.Key("buckets"sv).StartArray();
+            for (size_t bucket = 0; bucket < Histogram::BUCKET_COUNT; ++bucket) {
+                if (const uint64_t bucket_count = histogram.GetBucketCount(bucket); bucket_count > 0) {
+                    writer.StartArray()
+                        .Value(Histogram::GetBucketLimit(bucket))
+                        .Value(bucket_count)
+                        .EndArray();
+                }
+            }
+            writer.EndArray().EndDict();
+        }
+    }
+
+    void Histogram::Record(uint64_t value) {
+        buckets_[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t min = min_.load(std::memory_order_relaxed);
+        while (value < min && !min_.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+        }
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t Histogram::GetCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::GetSum() const {
+        return sum_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::GetMin() const {
+        return GetCount() > 0 ? min_.load(std::memory_order_relaxed) : 0;
+    }
+
+    uint64_t Histogram::GetMax() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::GetValueAtPercentile(double percentile) const {
+        const uint64_t count = GetCount();
+        if (count == 0) {
+            return 0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * count)));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+            seen += GetBucketCount(bucket);
+            if (seen >= rank) {
+                return std::min(GetBucketLimit(bucket), GetMax());
+            }
+        }
+        return GetMax();
+    }
+
+    uint64_t Histogram::GetBucketCount(size_t bucket) const {
+        return buckets_[bucket].load(std::memory_order_relaxed);
+    }
+
+    // Buckets [0, SUB_BUCKETS) hold one value each; after them every power of two from
+    // SUB_BUCKETS up has SUB_BUCKETS buckets, each 2^shift values wide
+    uint64_t Histogram::GetBucketLimit(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        const size_t shift = bucket / SUB_BUCKETS - 1;
+        const uint64_t lowest = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        return lowest + ((uint64_t{ 1 } << shift) - 1);
+    }
+
+    size_t Histogram::GetBucket(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        const int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return static_cast<size_t>(SUB_BUCKETS * (shift + 1) + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    void Enable() {
+        GetProfile();
+        detail::enabled.store(true);
+    }
+
+    void AddPhaseTime(Phase phase, std::chrono::nanoseconds time) {
+        Profile& profile = GetProfile();
+        profile.phase_time_ns[static_cast<size_t>(phase)].fetch_add(time.count(), std::memory_order_relaxed);
+        profile.phase_entries[static_cast<size_t>(phase)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Record(Distribution distribution, uint64_t value) {
+        GetProfile().distributions[static_cast<size_t>(distribution)].Record(value);
+    }
+
+    void Add(Counter counter, uint64_t value) {
+        GetProfile().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void WriteReport(std::ostream& output) {
+        const Profile& profile = GetProfile();
+        json::Writer writer(output);
+        writer.StartDict().Key("built_in"sv).Value(IsBuiltIn());
+
+        // Wall time, summed over every entry; phases entered from several threads at once
+        // can add up to more than the run took
+        writer.Key("phases"sv).StartDict();
+        for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+            if (const uint64_t entries = profile.phase_entries[phase].load(); entries > 0) {
+                writer.Key(PHASE_NAMES[phase]).StartDict().Key("count"sv).Value(entries);
+                writer.Key("total_ns"sv).Value(profile.phase_time_ns[phase].load());
+                writer.EndDict();
+            }
+        }
+        writer.EndDict();
+
+        writer.Key("requests"sv).StartDict();
+        for (size_t type = 0; type < std::size(REQUEST_NAMES); ++type) {
+            if (const Histogram& histogram = profile.distributions[type]; histogram.GetCount() > 0) {
+                writer.Key(REQUEST_NAMES[type]);
+                WriteHistogram(writer, histogram, "_ns"sv);
+            }
+        }
+        writer.EndDict();
+
+        writer.Key("router"sv).StartDict();
+        for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+            writer.Key(COUNTER_NAMES[counter]).Value(profile.counters[counter].load());
+        }
+        writer.Key("route_edges"sv);
+        WriteHistogram(writer, profile.distributions[static_cast<size_t>(Distribution::ROUTE_EDGES)], ""sv);
+        writer.EndDict();
+
+        writer.EndDict();
+        writer.Flush();
+        output << '\n';
+    }
+
+}  // namespace profile
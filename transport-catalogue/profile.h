@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+// Phase timers, latency histograms and counters for finding out where a run spends its time.
+// The code is hooked through the PROFILE_* macros below, which expand to nothing unless the
+// build defines TRANSPORT_CATALOGUE_PROFILING. Built in, they record only after Enable(); until
+// then each costs a relaxed atomic load, and values given to them are not even computed.
+// Everything may be recorded from any thread
+namespace profile {
+
+    enum class Phase {
+        PARSE_JSON,
+        DESERIALIZE,
+        BUILD_ROUTER,
+        RENDER_MAP,
+        ANSWER_REQUESTS,
+        COUNT
+    };
+
+    enum class Distribution {
+        // Time to answer one stat request of the type, in nanoseconds
+        STOP_REQUEST,
+        BUS_REQUEST,
+        ROUTE_REQUEST,
+        MAP_REQUEST,
+        // Edges of every route Router::BuildRoute finds
+        ROUTE_EDGES,
+        COUNT
+    };
+
+    enum class Counter {
+        // Candidate routes the router table build compared, and how many of them were shorter
+        ROUTER_RELAXATIONS,
+        ROUTER_IMPROVEMENTS,
+        ROUTES_FOUND,
+        ROUTES_NOT_FOUND,
+        COUNT
+    };
+
+    // Values are bucketed the way HdrHistogram does it: by their highest set bit, with every
+    // power-of-two range split into SUB_BUCKETS equal parts, so a value is known to within
+    // 1/SUB_BUCKETS of itself whatever its magnitude. Recording is a handful of atomic adds
+    class Histogram {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 5;
+        static constexpr uint64_t SUB_BUCKETS = uint64_t{ 1 } << SUB_BUCKET_BITS;
+        static constexpr size_t BUCKET_COUNT = SUB_BUCKETS * (64 - SUB_BUCKET_BITS + 1);
+
+        void Record(uint64_t value);
+
+        uint64_t GetCount() const;
+        uint64_t GetSum() const;
+        // 0 while empty
+        uint64_t GetMin() const;
+        uint64_t GetMax() const;
+        // The highest value of the bucket the percentile (0 to 100) falls in, at most GetMax()
+        uint64_t GetValueAtPercentile(double percentile) const;
+
+        uint64_t GetBucketCount(size_t bucket) const;
+        // The highest value that falls in the bucket
+        static uint64_t GetBucketLimit(size_t bucket);
+        static size_t GetBucket(uint64_t value);
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+        std::atomic<uint64_t> count_{ 0 };
+        std::atomic<uint64_t> sum_{ 0 };
+        std::atomic<uint64_t> min_{ UINT64_MAX };
+        std::atomic<uint64_t> max_{ 0 };
+    };
+
+    // Starts recording. Call it before starting the threads to be profiled
+    void Enable();
+
+    void AddPhaseTime(Phase phase, std::chrono::nanoseconds time);
+    void Record(Distribution distribution, uint64_t value);
+    void Add(Counter counter, uint64_t value);
+
+    // Everything recorded so far, as a JSON document
+    void WriteReport(std::ostream& output);
+
+    // Whether this build has the hooks in it; without them a report stays empty
+    constexpr bool IsBuiltIn() {
+#ifdef TRANSPORT_CATALOGUE_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    namespace detail {
+        extern std::atomic<bool> enabled;
+    }
+
+    inline bool IsEnabled() {
+        return detail::enabled.load(std::memory_order_relaxed);
+    }
+
+    // Adds the time from construction to destruction to a phase. A phase may be entered
+    // several times and from several threads; nested phases count in both
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(Phase phase)
+            : phase_(phase)
+            , enabled_(IsEnabled()) {
+            if (enabled_) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+        ~PhaseTimer() {
+            if (enabled_) {
+                AddPhaseTime(phase_, std::chrono::steady_clock::now() - start_);
+            }
+        }
+
+    private:
+        Phase phase_;
+        bool enabled_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Records the nanoseconds from construction to destruction in a distribution
+    class LatencyTimer {
+    public:
+        explicit LatencyTimer(Distribution distribution)
+            : distribution_(distribution)
+            , enabled_(IsEnabled()) {
+            if (enabled_) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+        LatencyTimer(const LatencyTimer&) = delete;
+        LatencyTimer& operator=(const LatencyTimer&) = delete;
+        ~LatencyTimer() {
+            if (enabled_) {
+                const auto time = std::chrono::steady_clock::now() - start_;
+                Record(distribution_, static_cast<uint64_t>(std::chrono::nanoseconds(time).count()));
+            }
+        }
+
+    private:
+        Distribution distribution_;
+        bool enabled_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+}  // namespace profile
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef TRANSPORT_CATALOGUE_PROFILING
+// Times the rest of the enclosing scope as the phase
+#define PROFILE_PHASE(phase) \
+    const ::profile::PhaseTimer PROFILE_CONCAT(profile_phase_, __LINE__)(::profile::Phase::phase)
+// Records the time of the rest of the enclosing scope in the distribution
+#define PROFILE_LATENCY(distribution) \
+    const ::profile::LatencyTimer PROFILE_CONCAT(profile_latency_, __LINE__)(::profile::Distribution::distribution)
+#define PROFILE_RECORD(distribution, value) \
+    (::profile::IsEnabled() ? ::profile::Record(::profile::Distribution::distribution, (value)) : void())
+#define PROFILE_ADD(counter, value) \
+    (::profile::IsEnabled() ? ::profile::Add(::profile::Counter::counter, (value)) : void())
+#else
+#define PROFILE_PHASE(phase) static_cast<void>(0)
+#define PROFILE_LATENCY(distribution) static_cast<void>(0)
+// The value is not evaluated, but variables kept only for it still count as used
+#define PROFILE_RECORD(distribution, value) static_cast<void>(sizeof(value))
+#define PROFILE_ADD(counter, value) static_cast<void>(sizeof(value))
+#endif
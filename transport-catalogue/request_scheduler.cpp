@@ -0,0 +1,132 @@
+#include "request_scheduler.h"
+
+#include <algorithm>
+
+namespace concurrency {
+
+    RequestScheduler::RequestScheduler(std::vector<ClassSettings> classes, size_t thread_count) {
+        classes_.reserve(classes.size());
+        for (const ClassSettings& settings : classes) {
+            classes_.push_back({ settings, {}, 0 });
+        }
+        if (thread_count == 0) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    RequestScheduler::~RequestScheduler() {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        wake_cv_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void RequestScheduler::Submit(size_t class_index, Task task) {
+        {
+            std::lock_guard lock(mutex_);
+            ClassQueue& queue = classes_.at(class_index);
+            // Arrivals are ordered by the mutex, so every queue stays sorted by due time
+            queue.requests.push_back({ Clock::now() + queue.settings.cost, std::move(task) });
+        }
+        wake_cv_.notify_one();
+    }
+
+    size_t RequestScheduler::PickClass() const {
+        size_t best = classes_.size();
+        for (size_t i = 0; i < classes_.size(); ++i) {
+            const ClassQueue& queue = classes_[i];
+            if (queue.requests.empty()
+                || (queue.settings.max_running != 0 && queue.running >= queue.settings.max_running)) {
+                continue;
+            }
+            if (best == classes_.size() || queue.requests.front().due < classes_[best].requests.front().due) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void RequestScheduler::WorkerLoop() {
+        std::unique_lock lock(mutex_);
+        while (true) {
+            size_t class_index = classes_.size();
+            wake_cv_.wait(lock, [this, &class_index] {
+                class_index = PickClass();
+                return class_index != classes_.size() || stop_;
+            });
+            if (class_index == classes_.size()) {
+                // Stopping. Whatever is still queued waits for a class limit, which a
+                // thread running a request of that class lifts when it is done
+                const bool drained = std::all_of(classes_.begin(), classes_.end(), [](const ClassQueue& queue) {
+                    return queue.requests.empty();
+                });
+                if (drained) {
+                    return;
+                }
+                wake_cv_.wait(lock);
+                continue;
+            }
+
+            ClassQueue& queue = classes_[class_index];
+            Task task = std::move(queue.requests.front().task);
+            queue.requests.pop_front();
+            ++queue.running;
+            lock.unlock();
+            task();
+            lock.lock();
+            --queue.running;
+            // A request held back by this class's limit may run now
+            if (!queue.requests.empty()) {
+                wake_cv_.notify_all();
+            }
+        }
+    }
+
+    TaskGroup::~TaskGroup() {
+        std::unique_lock lock(mutex_);
+        done_cv_.wait(lock, [this] { return remaining_ == 0; });
+    }
+
+    void TaskGroup::Submit(size_t class_index, std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex_);
+            ++remaining_;
+        }
+        scheduler_.Submit(class_index, [this, task = std::move(task)] {
+            try {
+                task();
+            }
+            catch (...) {
+                std::lock_guard lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+            // Counted down under the mutex so the waiter cannot return and destroy the
+            // group while this task is still touching it
+            std::lock_guard lock(mutex_);
+            if (--remaining_ == 0) {
+                done_cv_.notify_all();
+            }
+        });
+    }
+
+    void TaskGroup::Wait() {
+        std::unique_lock lock(mutex_);
+        done_cv_.wait(lock, [this] { return remaining_ == 0; });
+        if (error_) {
+            std::exception_ptr error = std::move(error_);
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+} // namespace concurrency
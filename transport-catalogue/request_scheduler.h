@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace concurrency {
+
+    // Fixed set of threads running requests from one FIFO queue per request class.
+    // Every class has an expected cost, and a request is due that long after it arrives;
+    // a free thread takes the queued request that is due first. So a cheap request that
+    // arrives after an expensive one is still run before it, while the expensive one,
+    // waiting, eventually is due before every newcomer and cannot starve. A class may
+    // also be limited to a number of threads at once, so that a burst of expensive
+    // requests always leaves threads for the cheap ones
+    class RequestScheduler {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Task = std::function<void()>;
+
+        struct ClassSettings {
+            Clock::duration cost;
+            // 0 means no limit
+            size_t max_running = 0;
+        };
+
+        // 0 threads means one per hardware thread
+        explicit RequestScheduler(std::vector<ClassSettings> classes, size_t thread_count = 0);
+        RequestScheduler(const RequestScheduler&) = delete;
+        RequestScheduler& operator=(const RequestScheduler&) = delete;
+        // Runs what is queued, then joins
+        ~RequestScheduler();
+
+        size_t GetThreadCount() const {
+            return threads_.size();
+        }
+
+        // The task must not throw
+        void Submit(size_t class_index, Task task);
+
+    private:
+        struct Request {
+            Clock::time_point due;
+            Task task;
+        };
+
+        struct ClassQueue {
+            ClassSettings settings;
+            std::deque<Request> requests;
+            size_t running = 0;
+        };
+
+        void WorkerLoop();
+        // The class whose first request is due first among those below their limit;
+        // classes_.size() if none can run now
+        size_t PickClass() const;
+
+        std::vector<ClassQueue> classes_;
+        std::vector<std::thread> threads_;
+        std::mutex mutex_;
+        std::condition_variable wake_cv_;
+        bool stop_ = false;
+    };
+
+    // Requests submitted together, waited for together
+    class TaskGroup {
+    public:
+        explicit TaskGroup(RequestScheduler& scheduler)
+            : scheduler_(scheduler) {
+        }
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+        // Waits for what is still running, as its tasks refer to the group
+        ~TaskGroup();
+
+        void Submit(size_t class_index, std::function<void()> task);
+        // Returns once every submitted task is done; rethrows the first exception one threw
+        void Wait();
+
+    private:
+        RequestScheduler& scheduler_;
+        std::mutex mutex_;
+        std::condition_variable done_cv_;
+        size_t remaining_ = 0;
+        std::exception_ptr error_;
+    };
+
+} // namespace concurrency
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "graph.h"
+#include "profile.h"
+#include "thread_pool.h"
 
 #include <algorithm>
 #include <cassert>
@@ -21,7 +23,24 @@ namespace graph {
         using Graph = DirectedWeightedGraph<Weight>;
 
     public:
+        // One cell of the all-pairs table, kept flat, row by row: the best known route from
+        // the row's vertex to the column's vertex, as its weight and its last edge
+        struct RouteEntry {
+            Weight weight;
+            uint32_t prev_edge;
+            uint32_t has_route;
+        };
+        // prev_edge of a route without edges
+        static constexpr uint32_t NO_EDGE = UINT32_MAX;
+
         explicit Router(const Graph& graph);
+        // The same table, with the rows of every relaxation step spread over the pool. Step k
+        // changes neither row k nor column k, so the rows are independent and the result
+        // matches the serial one bit for bit
+        Router(const Graph& graph, concurrency::WorkStealingPool& pool);
+        // Uses a table computed earlier, possibly by another process, instead of computing it.
+        // It holds GetVertexCount() squared entries and must outlive the router
+        Router(const Graph& graph, const RouteEntry* table);
 
         struct RouteInfo {
             Weight weight;
@@ -30,89 +49,162 @@ namespace graph {
 
         std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+        const RouteEntry* GetTable() const {
+            return table_;
+        }
+        size_t GetTableSize() const {
+            return vertex_count_ * vertex_count_;
+        }
+
     private:
-        struct RouteInternalData {
-            Weight weight;
-            std::optional<EdgeId> prev_edge;
-        };
-        using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+        RouteEntry& Entry(VertexId from, VertexId to) {
+            return own_table_[from * vertex_count_ + to];
+        }
+        const RouteEntry& Entry(VertexId from, VertexId to) const {
+            return table_[from * vertex_count_ + to];
+        }
 
         void InitializeRoutesInternalData(const Graph& graph) {
-            const size_t vertex_count = graph.GetVertexCount();
-            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-                routes_internal_data_[vertex][vertex] = RouteInternalData{ ZERO_WEIGHT, std::nullopt };
+            for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+                Entry(vertex, vertex) = RouteEntry{ ZERO_WEIGHT, NO_EDGE, 1 };
                 for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                     const auto& edge = graph.GetEdge(edge_id);
                     if (edge.weight < ZERO_WEIGHT) {
                         throw std::domain_error("Edges' weights should be non-negative");
                     }
-                    auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                    if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                        route_internal_data = RouteInternalData{ edge.weight, edge_id };
+                    auto& route_internal_data = Entry(vertex, edge.to);
+                    if (!route_internal_data.has_route || route_internal_data.weight > edge.weight) {
+                        route_internal_data = RouteEntry{ edge.weight, static_cast<uint32_t>(edge_id), 1 };
                     }
                 }
             }
         }
 
-        void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-            const RouteInternalData& route_to) {
-            auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
+        // Whether the route got shorter
+        bool RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteEntry& route_from,
+            const RouteEntry& route_to) {
+            auto& route_relaxing = Entry(vertex_from, vertex_to);
             const Weight candidate_weight = route_from.weight + route_to.weight;
-            if (!route_relaxing || candidate_weight < route_relaxing->weight) {
+            if (!route_relaxing.has_route || candidate_weight < route_relaxing.weight) {
                 route_relaxing = { candidate_weight,
-                                  route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge };
+                                  route_to.prev_edge != NO_EDGE ? route_to.prev_edge : route_from.prev_edge, 1 };
+                return true;
             }
+            return false;
+        }
+
+        void RelaxRoutesInternalDataThroughVertex(VertexId vertex_through) {
+            RelaxRowsThroughVertex(vertex_through, 0, vertex_count_);
         }
 
-        void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-            for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-                if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                    for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                        if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                            RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+        void RelaxRowsThroughVertex(VertexId vertex_through, VertexId first_row, VertexId last_row) {
+            // Counted locally and added once per call, so the loop stays free of atomics.
+            // Every row with a route to vertex_through is relaxed with each route from it,
+            // so the relaxations need not be counted one by one
+            uint64_t rows_relaxed = 0;
+            uint64_t improvements = 0;
+            for (VertexId vertex_from = first_row; vertex_from < last_row; ++vertex_from) {
+                if (const auto& route_from = Entry(vertex_from, vertex_through); route_from.has_route) {
+                    ++rows_relaxed;
+                    for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                        if (const auto& route_to = Entry(vertex_through, vertex_to); route_to.has_route) {
+                            if (RelaxRoute(vertex_from, vertex_to, route_from, route_to)) {
+                                ++improvements;
+                            }
                         }
                     }
                 }
             }
+            PROFILE_ADD(ROUTER_RELAXATIONS, rows_relaxed * CountRoutesFrom(vertex_through));
+            PROFILE_ADD(ROUTER_IMPROVEMENTS, improvements);
+        }
+
+        uint64_t CountRoutesFrom(VertexId vertex_from) const {
+            const RouteEntry* row = table_ + vertex_from * vertex_count_;
+            return std::count_if(row, row + vertex_count_, [](const RouteEntry& entry) {
+                return entry.has_route != 0;
+            });
         }
 
         static constexpr Weight ZERO_WEIGHT = Weight();
         const Graph& graph_;
-        RoutesInternalData routes_internal_data_;
+        size_t vertex_count_;
+        std::vector<RouteEntry> own_table_;
+        const RouteEntry* table_;
     };
 
     template <typename Weight>
     Router<Weight>::Router(const Graph& graph)
         : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , own_table_(vertex_count_ * vertex_count_, RouteEntry{ ZERO_WEIGHT, NO_EDGE, 0 })
+        , table_(own_table_.data())
     {
-        auto a = sizeof(RouteInternalData);
-        const size_t vertex_count = graph.GetVertexCount();
-        routes_internal_data_ = { graph.GetVertexCount(), std::vector<std::optional<RouteInternalData>>(graph_.GetVertexCount()) };
+        PROFILE_PHASE(BUILD_ROUTER);
+        if (graph.GetEdgeCount() >= NO_EDGE) {
+            throw std::length_error("Too many edges for the route table");
+        }
 
         InitializeRoutesInternalData(graph);
 
-        // const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-            RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+        for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+            RelaxRoutesInternalDataThroughVertex(vertex_through);
         }
     }
 
+    template <typename Weight>
+    Router<Weight>::Router(const Graph& graph, concurrency::WorkStealingPool& pool)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , own_table_(vertex_count_ * vertex_count_, RouteEntry{ ZERO_WEIGHT, NO_EDGE, 0 })
+        , table_(own_table_.data())
+    {
+        PROFILE_PHASE(BUILD_ROUTER);
+        if (graph.GetEdgeCount() >= NO_EDGE) {
+            throw std::length_error("Too many edges for the route table");
+        }
+
+        InitializeRoutesInternalData(graph);
+
+        // Each step is O(V^2) and the steps run in order, so a chunk is a band of rows
+        const size_t grain = std::max<size_t>(1, vertex_count_ / (pool.GetThreadCount() * 4));
+        for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+            pool.ParallelFor(vertex_count_, grain, [this, vertex_through](size_t begin, size_t end) {
+                RelaxRowsThroughVertex(vertex_through, begin, end);
+            });
+        }
+    }
+
+    template <typename Weight>
+    Router<Weight>::Router(const Graph& graph, const RouteEntry* table)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , table_(table)
+    {
+    }
+
     template <typename Weight>
     std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
         VertexId to) const {
-        const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-        if (!route_internal_data) {
+        if (from >= vertex_count_ || to >= vertex_count_) {
+            throw std::out_of_range("No such vertex");
+        }
+        const RouteEntry& route_internal_data = Entry(from, to);
+        if (!route_internal_data.has_route) {
+            PROFILE_ADD(ROUTES_NOT_FOUND, 1);
             return std::nullopt;
         }
-        const Weight weight = route_internal_data->weight;
+        const Weight weight = route_internal_data.weight;
         std::vector<EdgeId> edges;
-        for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-            edge_id;
-            edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+        for (uint32_t edge_id = route_internal_data.prev_edge;
+            edge_id != NO_EDGE;
+            edge_id = Entry(from, graph_.GetEdge(edge_id).from).prev_edge)
         {
-            edges.push_back(*edge_id);
+            edges.push_back(edge_id);
         }
         std::reverse(edges.begin(), edges.end());
+        PROFILE_ADD(ROUTES_FOUND, 1);
+        PROFILE_RECORD(ROUTE_EDGES, edges.size());
 
         return RouteInfo{ weight, std::move(edges) };
     }
@@ -0,0 +1,115 @@
+#include "router_table.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace graph {
+
+    namespace {
+        constexpr uint64_t MAGIC = 0x31425452'47415254ULL;  // "TRAGRTB1"
+        constexpr uint32_t VERSION = 1;
+
+        struct Header {
+            uint64_t magic;
+            uint32_t version;
+            uint32_t entry_size;
+            uint64_t vertex_count;
+            uint64_t edge_count;
+            uint64_t graph_checksum;
+        };
+
+        // FNV-1a over the edges' ends and weights
+        uint64_t ComputeChecksum(const DirectedWeightedGraph<double>& graph) {
+            uint64_t hash = 14695981039346656037ULL;
+            auto mix = [&hash](const void* data, size_t size) {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < size; ++i) {
+                    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+                }
+            };
+            for (EdgeId id = 0; id < graph.GetEdgeCount(); ++id) {
+                const auto& edge = graph.GetEdge(id);
+                const uint64_t ends[] = { edge.from, edge.to };
+                mix(ends, sizeof(ends));
+                mix(&edge.weight, sizeof(edge.weight));
+            }
+            return hash;
+        }
+
+        Header MakeHeader(const DirectedWeightedGraph<double>& graph) {
+            return { MAGIC, VERSION, sizeof(RouterTableEntry), graph.GetVertexCount(), graph.GetEdgeCount(),
+                     ComputeChecksum(graph) };
+        }
+    }
+
+    void SaveRouterTable(const Router<double>& router, const DirectedWeightedGraph<double>& graph,
+                         const std::string& path) {
+        const Header header = MakeHeader(graph);
+        const std::string temp_path = path + ".tmp";
+        {
+            std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+            output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            output.write(reinterpret_cast<const char*>(router.GetTable()),
+                         router.GetTableSize() * sizeof(RouterTableEntry));
+            if (!output.flush()) {
+                throw std::runtime_error("Cannot write router table " + temp_path);
+            }
+        }
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "rename " + temp_path);
+        }
+    }
+
+    MappedRouterTable::MappedRouterTable(const std::string& path, const DirectedWeightedGraph<double>& graph) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        struct stat file_stat{};
+        if (fstat(fd, &file_stat) < 0) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "fstat " + path);
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        const Header expected = MakeHeader(graph);
+        const size_t entry_count = static_cast<size_t>(expected.vertex_count * expected.vertex_count);
+        if (size_ != sizeof(Header) + entry_count * sizeof(RouterTableEntry)) {
+            close(fd);
+            throw std::runtime_error("Router table does not match the base: " + path);
+        }
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        const int error = errno;
+        // The mapping holds its own reference to the file
+        close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::system_error(error, std::generic_category(), "mmap " + path);
+        }
+
+        Header header;
+        std::memcpy(&header, data_, sizeof(header));
+        if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+            munmap(data_, size_);
+            throw std::runtime_error("Router table does not match the base: " + path);
+        }
+        entries_ = reinterpret_cast<const RouterTableEntry*>(static_cast<const char*>(data_) + sizeof(Header));
+    }
+
+    MappedRouterTable::~MappedRouterTable() {
+        if (data_) {
+            munmap(data_, size_);
+        }
+    }
+
+}  // namespace graph
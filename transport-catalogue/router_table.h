@@ -0,0 +1,39 @@
+#pragma once
+
+#include "router.h"
+
+#include <cstddef>
+#include <string>
+
+namespace graph {
+
+    using RouterTableEntry = Router<double>::RouteEntry;
+
+    // Writes the router's all-pairs table to path, headed by the shape and a checksum of
+    // the graph it was computed on. Written to a temporary file first and renamed over
+    // path, so a process mapping the old table keeps a consistent copy
+    void SaveRouterTable(const Router<double>& router, const DirectedWeightedGraph<double>& graph,
+                         const std::string& path);
+
+    // A table written by SaveRouterTable, mapped read-only and shared. Every process that
+    // maps the same file shares its pages, so the table is in memory once however many
+    // processes answer from it. Throws if the file cannot be mapped or was computed on
+    // another graph
+    class MappedRouterTable {
+    public:
+        MappedRouterTable(const std::string& path, const DirectedWeightedGraph<double>& graph);
+        MappedRouterTable(const MappedRouterTable&) = delete;
+        MappedRouterTable& operator=(const MappedRouterTable&) = delete;
+        ~MappedRouterTable();
+
+        const RouterTableEntry* GetEntries() const {
+            return entries_;
+        }
+
+    private:
+        void* data_ = nullptr;
+        size_t size_ = 0;
+        const RouterTableEntry* entries_ = nullptr;
+    };
+
+}  // namespace graph
@@ -2,16 +2,47 @@
 #include "map_renderer.h"
 #include "svg.h"
 #include "graph.h"
+#include "profile.h"
 
+#include <algorithm>
 #include <fstream>
+#include <stdexcept>
 #include <string_view>
 #include <string>
+#include <type_traits>
 
 using namespace std;
 
 namespace transport_catalogue {
 namespace detail {
 
+namespace {
+// Fills field with count messages, the i-th made by pack(i). With a pool the elements are
+// added first and then filled in place on it; each is a separate message, so they can be
+// filled at once
+template <typename Message, typename Pack>
+void PackRepeated(google::protobuf::RepeatedPtrField<Message>& field, size_t count,
+                  concurrency::WorkStealingPool* pool, Pack pack) {
+    constexpr size_t CHUNK_SIZE = 1024;
+    field.Reserve(static_cast<int>(field.size() + count));
+    if (!pool) {
+        for (size_t i = 0; i < count; ++i) {
+            *field.Add() = pack(i);
+        }
+        return;
+    }
+    const int first = field.size();
+    for (size_t i = 0; i < count; ++i) {
+        field.Add();
+    }
+    pool->ParallelFor(count, CHUNK_SIZE, [&field, &pack, first](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            *field.Mutable(first + static_cast<int>(i)) = pack(i);
+        }
+    });
+}
+}
+
 transport_catalogue_serialize::Color PackColor(const svg::Color& svg_color) {
     transport_catalogue_serialize::Color ser_color;
     if (holds_alternative<string>(svg_color)) {
@@ -132,6 +163,8 @@ transport_catalogue_serialize::RenderSettings PackRenderSettings(const map_rende
         *ser_render_settings.mutable_color_palette()->Add() = PackColor(svg_color);
     }
 
+    ser_render_settings.set_simplify_tolerance(render_settings.simplify_tolerance);
+
     return ser_render_settings;
 }
 
@@ -143,18 +176,19 @@ transport_catalogue_serialize::RoutingSettings PackRoutingSettings(const Routing
     return ser_routing_settings;
 }
 
-transport_catalogue_serialize::DirectedWeightedGraph PackGraph(const graph::DirectedWeightedGraph<double>& gr) {
+transport_catalogue_serialize::DirectedWeightedGraph PackGraph(const graph::DirectedWeightedGraph<double>& gr,
+                                                               concurrency::WorkStealingPool* pool) {
     transport_catalogue_serialize::DirectedWeightedGraph ser_gr;
-    transport_catalogue_serialize::Edge ser_edge;
-    for (const graph::Edge<double>& edge : gr) {
+    PackRepeated(*ser_gr.mutable_edges(), gr.GetEdgeCount(), pool, [&gr](size_t i) {
+        const graph::Edge<double>& edge = gr.GetEdge(i);
+        transport_catalogue_serialize::Edge ser_edge;
         ser_edge.set_from_id(edge.from);
         ser_edge.set_to_id(edge.to);
         ser_edge.set_span_count(edge.span_count);
         ser_edge.set_bus_name(string(edge.bus_name));
         ser_edge.set_weight(edge.weight);
-
-        *ser_gr.mutable_edges()->Add() = ser_edge;
-    }
+        return ser_edge;
+    });
 
     return ser_gr;
 }
@@ -188,6 +222,8 @@ map_renderer::detail::RenderSettings UnpackRenderSettings(const transport_catalo
         render_settings.color_palette.push_back(UnpackColor(ser_render_settings.color_palette(i)));
     }
 
+    render_settings.simplify_tolerance = ser_render_settings.simplify_tolerance();
+
     return render_settings;
 }
 
@@ -217,33 +253,63 @@ graph::DirectedWeightedGraph<double> UnpackGraph(const transport_catalogue_seria
 }
 } // namespace detail
 
-void Serialize(const TransportCatalogue& catalogue, const string& filename) {
+void Serialize(const TransportCatalogue& catalogue, const string& filename, bool store_rendered_map,
+               concurrency::WorkStealingPool* pool) {
     transport_catalogue_serialize::TransportCatalogue cat_to_serialize;
     const std::deque<Stop>& stops = catalogue.GetStops();
     const std::deque<Bus>& buses = catalogue.GetBuses();
     
-    for (const Stop& stop : stops) {
-        *cat_to_serialize.mutable_stops()->Add() = detail::PackStop(stop);
+    detail::PackRepeated(*cat_to_serialize.mutable_stops(), stops.size(), pool, [&stops](size_t i) {
+        return detail::PackStop(stops[i]);
+    });
+    detail::PackRepeated(*cat_to_serialize.mutable_buses(), buses.size(), pool, [&buses, &catalogue](size_t i) {
+        return detail::PackBus(buses[i], catalogue);
+    });
+
+    // Simplified map lines are computed here once instead of by every process_requests run
+    if (catalogue.GetRenderSettings().simplify_tolerance > 0) {
+        const std::vector<std::vector<uint32_t>>& polylines = catalogue.GetMapRenderer().GetSimplifiedPolylines();
+        for (size_t i = 0; i < polylines.size(); ++i) {
+            cat_to_serialize.mutable_buses(i)->mutable_simplified_stop_index()->Add(polylines[i].begin(), polylines[i].end());
+        }
     }
 
-    for (const Bus& bus : buses) {
-        *cat_to_serialize.mutable_buses()->Add() = detail::PackBus(bus, catalogue);
+    // By stop ids: the hash map's order follows the stops' addresses, which differ from run
+    // to run once the base is built on several threads, and the file should not
+    using DistanceEntry = std::decay_t<decltype(catalogue.GetDistances())>::value_type;
+    std::vector<const DistanceEntry*> distances;
+    distances.reserve(catalogue.GetDistances().size());
+    for (const DistanceEntry& entry : catalogue.GetDistances()) {
+        distances.push_back(&entry);
     }
-
-    for (const auto& [stop_ptr_pair, distance] : catalogue.GetDistances()) {
-        *cat_to_serialize.mutable_distances()->Add() = detail::PackDistance(stop_ptr_pair, distance, catalogue);
+    std::sort(distances.begin(), distances.end(), [](const DistanceEntry* lhs, const DistanceEntry* rhs) {
+        return std::pair(lhs->first.first->id, lhs->first.second->id) < std::pair(rhs->first.first->id, rhs->first.second->id);
+    });
+    for (const DistanceEntry* entry : distances) {
+        *cat_to_serialize.mutable_distances()->Add() = detail::PackDistance(entry->first, entry->second, catalogue);
     }
 
     const map_renderer::detail::RenderSettings& render_settings = catalogue.GetRenderSettings();
     *cat_to_serialize.mutable_render_settings() = detail::PackRenderSettings(render_settings);
 
+    // The projection depends only on what is fixed here, so it is done once
+    for (const svg::Point& point : catalogue.GetMapRenderer().GetStopPoints()) {
+        transport_catalogue_serialize::Point& ser_point = *cat_to_serialize.mutable_stop_points()->Add();
+        ser_point.set_x(point.x);
+        ser_point.set_y(point.y);
+    }
+
 
     const transport_catalogue::RoutingSettings& routing_settings = catalogue.GetRoutingSettings();
     *cat_to_serialize.mutable_routing_settings() = detail::PackRoutingSettings(routing_settings);
 
 
     const graph::DirectedWeightedGraph<double>& gr = catalogue.GetGraphConstRef();
-    *cat_to_serialize.mutable_graph() = detail::PackGraph(gr);
+    *cat_to_serialize.mutable_graph() = detail::PackGraph(gr, pool);
+
+    if (store_rendered_map) {
+        cat_to_serialize.set_rendered_map(catalogue.GetRenderedMap());
+    }
 
     std::ofstream ofs(filename, ios::binary);
     cat_to_serialize.SerializeToOstream(&ofs);
@@ -251,47 +317,76 @@ void Serialize(const TransportCatalogue& catalogue, const string& filename) {
 }
 
 void Deserialize(const string& filename, TransportCatalogue& catalogue) {
+    PROFILE_PHASE(DESERIALIZE);
     transport_catalogue_serialize::TransportCatalogue cat_serialized;
     ifstream ifs(filename, ios::binary);
-    cat_serialized.ParseFromIstream(&ifs);
+    if (!ifs || !cat_serialized.ParseFromIstream(&ifs)) {
+        throw std::runtime_error("Cannot read the base from " + filename);
+    }
     ifs.close();
 
     size_t stops_count = cat_serialized.stops_size();
     for (size_t i = 0; i < stops_count; ++i) {
-        transport_catalogue_serialize::Stop ser_stop = cat_serialized.stops(i);
+        const transport_catalogue_serialize::Stop& ser_stop = cat_serialized.stops(i);
         catalogue.AddStop( ser_stop.name(), {ser_stop.coordinates().lat(), ser_stop.coordinates().lng()} );
     }
 
     size_t buses_count = cat_serialized.buses_size();
     for (size_t i = 0; i < buses_count; ++i) {
-        transport_catalogue_serialize::Bus ser_bus = cat_serialized.buses(i);
-        std::vector<std::string> stops;
+        const transport_catalogue_serialize::Bus& ser_bus = cat_serialized.buses(i);
+        std::vector<std::string_view> stops;
         size_t stops_count = ser_bus.stop_index_size();
+        stops.reserve(stops_count);
         for (size_t j = 0; j < stops_count; ++j) {
             stops.push_back(catalogue.GetStopnameByIndex(ser_bus.stop_index(j)));
         }
         catalogue.AddBus(ser_bus.name(), stops, ser_bus.is_roundtrip());
     }
 
+    std::vector<std::vector<uint32_t>> simplified_polylines;
+    for (size_t i = 0; i < buses_count; ++i) {
+        const auto& kept = cat_serialized.buses(i).simplified_stop_index();
+        if (!kept.empty()) {
+            simplified_polylines.resize(buses_count);
+            simplified_polylines[i].assign(kept.begin(), kept.end());
+        }
+    }
+    if (!simplified_polylines.empty()) {
+        catalogue.SetSimplifiedPolylines(move(simplified_polylines));
+    }
+
     size_t distances_count = cat_serialized.distances_size();
     for (size_t i = 0; i < distances_count; ++i) {
-        transport_catalogue_serialize::StopPairDistance stop_pair_distance = cat_serialized.distances(i);
-        std::string stop1_name = catalogue.GetStopnameByIndex(stop_pair_distance.stop1_index());
-        std::string stop2_name = catalogue.GetStopnameByIndex(stop_pair_distance.stop2_index());
+        const transport_catalogue_serialize::StopPairDistance& stop_pair_distance = cat_serialized.distances(i);
+        const std::string& stop1_name = catalogue.GetStopnameByIndex(stop_pair_distance.stop1_index());
+        const std::string& stop2_name = catalogue.GetStopnameByIndex(stop_pair_distance.stop2_index());
         double distance = stop_pair_distance.distance();
 
         catalogue.SetDistance(stop1_name, stop2_name, distance);
     }
 
-    transport_catalogue_serialize::RenderSettings ser_render_settings = cat_serialized.render_settings();
+    const transport_catalogue_serialize::RenderSettings& ser_render_settings = cat_serialized.render_settings();
     catalogue.SetRenderSettings(detail::UnpackRenderSettings(ser_render_settings));
 
-    transport_catalogue_serialize::RoutingSettings ser_routing_settings = cat_serialized.routing_settings();
+    std::vector<svg::Point> stop_points;
+    stop_points.reserve(cat_serialized.stop_points_size());
+    for (const transport_catalogue_serialize::Point& ser_point : cat_serialized.stop_points()) {
+        stop_points.push_back({ ser_point.x(), ser_point.y() });
+    }
+    catalogue.SetStopPoints(move(stop_points));
+
+    const transport_catalogue_serialize::RoutingSettings& ser_routing_settings = cat_serialized.routing_settings();
     catalogue.SetRoutingSettings(detail::UnpackRoutingSettings(ser_routing_settings));
 
     
-    transport_catalogue_serialize::DirectedWeightedGraph ser_graph = cat_serialized.graph();
+    const transport_catalogue_serialize::DirectedWeightedGraph& ser_graph = cat_serialized.graph();
     catalogue.SetGraph(detail::UnpackGraph(ser_graph, catalogue.GetStops().size()));
+
+    if (cat_serialized.has_rendered_map()) {
+        catalogue.SetRenderedMap(move(*cat_serialized.mutable_rendered_map()));
+    }
+
+    catalogue.Freeze();
 }
 
 } // namespace transport_catalogue
\ No newline at end of file
@@ -23,10 +23,16 @@ namespace detail {
     transport_catalogue_serialize::RoutingSettings PackRoutingSettings(const RoutingSettings& routing_settings);
     RoutingSettings UnpackRoutingSettings(const transport_catalogue_serialize::RoutingSettings& ser_routing_settings);
 
-    transport_catalogue_serialize::DirectedWeightedGraph PackGraph(const graph::DirectedWeightedGraph<double>& gr);
+    // With a pool the edges are packed on it
+    transport_catalogue_serialize::DirectedWeightedGraph PackGraph(const graph::DirectedWeightedGraph<double>& gr,
+                                                                   concurrency::WorkStealingPool* pool = nullptr);
     graph::DirectedWeightedGraph<double> UnpackGraph(const transport_catalogue_serialize::DirectedWeightedGraph& ser_gr, size_t vertex_count);
 } // namespace detail
 
-    void Serialize(const TransportCatalogue& catalogue, const std::string& filename);
+    // With store_rendered_map the map is rendered now and saved along with the base.
+    // With a pool the stops, buses and edges are packed on it; the file is the same
+    void Serialize(const TransportCatalogue& catalogue, const std::string& filename, bool store_rendered_map = false,
+                   concurrency::WorkStealingPool* pool = nullptr);
+    // Fills and freezes the catalogue. Throws std::runtime_error if the file cannot be read or parsed
     void Deserialize(const std::string& filename, TransportCatalogue& catalogue);
 } // namespace transport_catalogue
\ No newline at end of file
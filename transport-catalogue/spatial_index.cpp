@@ -0,0 +1,151 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace map_renderer {
+
+    namespace {
+        // Average number of segments per cell the grid is sized for
+        constexpr double SEGMENTS_PER_CELL = 4.0;
+        constexpr size_t MAX_GRID_SIDE = 1024;
+
+        Rect BoundingBox(const GridIndex::Segment& segment) {
+            return { std::min(segment.from.x, segment.to.x), std::min(segment.from.y, segment.to.y),
+                     std::max(segment.from.x, segment.to.x), std::max(segment.from.y, segment.to.y) };
+        }
+
+        // Liang-Barsky: clips the segment against rect and reports whether anything is left
+        bool Crosses(const GridIndex::Segment& segment, const Rect& rect) {
+            const double dx = segment.to.x - segment.from.x;
+            const double dy = segment.to.y - segment.from.y;
+            const double p[] = { -dx, dx, -dy, dy };
+            const double q[] = { segment.from.x - rect.min_x, rect.max_x - segment.from.x,
+                                 segment.from.y - rect.min_y, rect.max_y - segment.from.y };
+            double t_enter = 0.0;
+            double t_leave = 1.0;
+            for (int i = 0; i < 4; ++i) {
+                if (p[i] == 0.0) {
+                    // Parallel to this edge: inside the slab or not at all
+                    if (q[i] < 0.0) {
+                        return false;
+                    }
+                    continue;
+                }
+                const double t = q[i] / p[i];
+                if (p[i] < 0.0) {
+                    t_enter = std::max(t_enter, t);
+                }
+                else {
+                    t_leave = std::min(t_leave, t);
+                }
+                if (t_enter > t_leave) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    GridIndex::GridIndex(std::vector<Segment> segments)
+        : segments_(std::move(segments)) {
+        if (segments_.empty()) {
+            return;
+        }
+
+        bounds_ = BoundingBox(segments_.front());
+        for (const Segment& segment : segments_) {
+            const Rect box = BoundingBox(segment);
+            bounds_.min_x = std::min(bounds_.min_x, box.min_x);
+            bounds_.min_y = std::min(bounds_.min_y, box.min_y);
+            bounds_.max_x = std::max(bounds_.max_x, box.max_x);
+            bounds_.max_y = std::max(bounds_.max_y, box.max_y);
+        }
+
+        const size_t side = std::clamp<size_t>(
+            static_cast<size_t>(std::ceil(std::sqrt(segments_.size() / SEGMENTS_PER_CELL))), 1, MAX_GRID_SIDE);
+        columns_ = side;
+        rows_ = side;
+        cell_width_ = std::max((bounds_.max_x - bounds_.min_x) / columns_, 1e-9);
+        cell_height_ = std::max((bounds_.max_y - bounds_.min_y) / rows_, 1e-9);
+
+        // Two passes over the segments: count per cell, then fill the flat cell lists.
+        // A segment is listed in the cells it passes through: row by row, only the columns
+        // between where it enters and leaves the row, so a long diagonal segment takes cells
+        // in proportion to its length rather than to its bounding box. The rows are widened
+        // a little, so rounding can add a cell but never drop one
+        auto for_each_cell = [this](const Segment& segment, auto&& action) {
+            const Rect box = BoundingBox(segment);
+            const size_t first_row = CellRow(box.min_y);
+            const size_t last_row = CellRow(box.max_y);
+            const double dx = segment.to.x - segment.from.x;
+            const double dy = segment.to.y - segment.from.y;
+            const double margin = cell_height_ * 1e-6;
+            for (size_t row = first_row; row <= last_row; ++row) {
+                double min_x = box.min_x;
+                double max_x = box.max_x;
+                if (first_row != last_row) {
+                    const double row_min_y = std::max(box.min_y, bounds_.min_y + row * cell_height_ - margin);
+                    const double row_max_y = std::min(box.max_y, bounds_.min_y + (row + 1) * cell_height_ + margin);
+                    const double x_at_min_y = segment.from.x + (row_min_y - segment.from.y) / dy * dx;
+                    const double x_at_max_y = segment.from.x + (row_max_y - segment.from.y) / dy * dx;
+                    min_x = std::max(box.min_x, std::min(x_at_min_y, x_at_max_y));
+                    max_x = std::min(box.max_x, std::max(x_at_min_y, x_at_max_y));
+                }
+                const size_t last_column = CellColumn(max_x);
+                for (size_t column = CellColumn(min_x); column <= last_column; ++column) {
+                    action(row * columns_ + column);
+                }
+            }
+        };
+
+        cell_begin_.assign(columns_ * rows_ + 1, 0);
+        for (const Segment& segment : segments_) {
+            for_each_cell(segment, [this](size_t cell) {
+                ++cell_begin_[cell + 1];
+            });
+        }
+        for (size_t cell = 1; cell < cell_begin_.size(); ++cell) {
+            cell_begin_[cell] += cell_begin_[cell - 1];
+        }
+        cell_segments_.resize(cell_begin_.back());
+        std::vector<uint32_t> fill(cell_begin_.begin(), cell_begin_.end() - 1);
+        for (uint32_t i = 0; i < segments_.size(); ++i) {
+            for_each_cell(segments_[i], [this, &fill, i](size_t cell) {
+                cell_segments_[fill[cell]++] = i;
+            });
+        }
+    }
+
+    size_t GridIndex::CellColumn(double x) const {
+        const double column = std::floor((x - bounds_.min_x) / cell_width_);
+        return static_cast<size_t>(std::clamp(column, 0.0, static_cast<double>(columns_ - 1)));
+    }
+
+    size_t GridIndex::CellRow(double y) const {
+        const double row = std::floor((y - bounds_.min_y) / cell_height_);
+        return static_cast<size_t>(std::clamp(row, 0.0, static_cast<double>(rows_ - 1)));
+    }
+
+    void GridIndex::Query(const Rect& rect, std::vector<uint32_t>& payloads) const {
+        if (segments_.empty() || rect.max_x < bounds_.min_x || rect.min_x > bounds_.max_x
+            || rect.max_y < bounds_.min_y || rect.min_y > bounds_.max_y) {
+            return;
+        }
+        const size_t first_column = CellColumn(rect.min_x);
+        const size_t last_column = CellColumn(rect.max_x);
+        const size_t last_row = CellRow(rect.max_y);
+        for (size_t row = CellRow(rect.min_y); row <= last_row; ++row) {
+            for (size_t column = first_column; column <= last_column; ++column) {
+                const size_t cell = row * columns_ + column;
+                for (uint32_t i = cell_begin_[cell]; i < cell_begin_[cell + 1]; ++i) {
+                    const Segment& segment = segments_[cell_segments_[i]];
+                    if (Crosses(segment, rect)) {
+                        payloads.push_back(segment.payload);
+                    }
+                }
+            }
+        }
+    }
+
+} // namespace map_renderer
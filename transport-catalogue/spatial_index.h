@@ -0,0 +1,54 @@
+#pragma once
+
+#include "svg.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace map_renderer {
+
+    struct Rect {
+        double min_x = 0;
+        double min_y = 0;
+        double max_x = 0;
+        double max_y = 0;
+
+        bool Contains(svg::Point point) const {
+            return point.x >= min_x && point.x <= max_x && point.y >= min_y && point.y <= max_y;
+        }
+    };
+
+    // Uniform grid over segments in map pixels; a point is a segment with equal ends.
+    // Each segment carries a payload id (a bus or a stop), and a query returns the
+    // payloads of the segments crossing a rectangle, looking only at the cells it covers
+    class GridIndex {
+    public:
+        struct Segment {
+            svg::Point from;
+            svg::Point to;
+            uint32_t payload;
+        };
+
+        GridIndex() = default;
+        explicit GridIndex(std::vector<Segment> segments);
+
+        // Appends the payload of every segment that crosses rect. A payload shows up
+        // once per matching segment, so callers that need a set deduplicate
+        void Query(const Rect& rect, std::vector<uint32_t>& payloads) const;
+
+    private:
+        size_t CellColumn(double x) const;
+        size_t CellRow(double y) const;
+
+        std::vector<Segment> segments_;
+        Rect bounds_;
+        size_t columns_ = 0;
+        size_t rows_ = 0;
+        double cell_width_ = 1;
+        double cell_height_ = 1;
+        // Cell c holds cell_segments_[cell_begin_[c], cell_begin_[c + 1])
+        std::vector<uint32_t> cell_begin_;
+        std::vector<uint32_t> cell_segments_;
+    };
+
+} // namespace map_renderer
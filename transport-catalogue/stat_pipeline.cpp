@@ -0,0 +1,268 @@
+#include "stat_pipeline.h"
+#include "bounded_queue.h"
+#include "json_reader.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace transport_catalogue {
+	namespace json_handler {
+
+		using namespace std::literals;
+
+		namespace {
+
+			struct StatBatch {
+				size_t seq;
+				std::vector<json::Node> requests;
+			};
+
+			class StatPipeline {
+			public:
+				StatPipeline(json::ArrayStream& requests, const JsonReader& reader,
+					std::shared_future<void> base_ready, const std::unique_ptr<JsonReader::Router>& router,
+					std::ostream& output, const PipelineSettings& settings)
+					: requests_(requests)
+					, reader_(reader)
+					, base_ready_(std::move(base_ready))
+					, router_(router)
+					, output_(output)
+					, settings_(settings)
+					, queue_(settings.queue_capacity) {
+				}
+
+				void Run() {
+					const size_t worker_count = settings_.worker_count != 0
+						? settings_.worker_count
+						: std::max(1u, std::thread::hardware_concurrency());
+
+					std::vector<std::thread> threads;
+					threads.reserve(worker_count + 1);
+					threads.emplace_back([this] { ParseRequests(); });
+					for (size_t i = 0; i < worker_count; ++i) {
+						// Every thread waits on its own copy of the future
+						threads.emplace_back([this, base_ready = base_ready_] { ComputeResponses(base_ready); });
+					}
+
+					json::Writer writer(output_, settings_.format);
+					try {
+						writer.StartArray();
+						EmitResponses(writer);
+					}
+					catch (...) {
+						Fail(std::current_exception());
+					}
+					for (std::thread& thread : threads) {
+						thread.join();
+					}
+					if (error_) {
+						std::rethrow_exception(error_);
+					}
+					writer.EndArray();
+					writer.Flush();
+				}
+
+			private:
+				// Producer: cuts the stat_requests array into batches, but never gets more than
+				// reorder_window batches ahead of the writer
+				void ParseRequests() {
+					try {
+						const size_t batch_size = std::max<size_t>(settings_.batch_size, 1);
+						size_t seq = 0;
+						for (bool more = true; more; ++seq) {
+							std::vector<json::Node> requests;
+							requests.reserve(batch_size);
+							while (requests.size() < batch_size) {
+								std::optional<json::Node> request = requests_.Next();
+								if (!request) {
+									more = false;
+									break;
+								}
+								requests.push_back(std::move(*request));
+							}
+							if (requests.empty()) {
+								break;
+							}
+							{
+								std::unique_lock lock(mutex_);
+								window_cv_.wait(lock, [this, seq] {
+									return error_ || seq < emitted_ + settings_.reorder_window;
+								});
+								if (error_) {
+									return;
+								}
+							}
+							if (!queue_.Push(StatBatch{ seq, std::move(requests) })) {
+								return;
+							}
+						}
+						{
+							std::lock_guard lock(mutex_);
+							total_ = seq;
+						}
+						ready_cv_.notify_all();
+					}
+					catch (...) {
+						Fail(std::current_exception());
+					}
+					// Workers drain what is left and stop
+					queue_.Close();
+				}
+
+				void ComputeResponses(const std::shared_future<void>& base_ready) {
+					try {
+						// Requests are parsed while the base is still loading; computing has to wait
+						base_ready.get();
+						while (std::optional<StatBatch> batch = queue_.Pop()) {
+							if (failed_) {
+								return;
+							}
+							std::vector<std::string> responses(batch->requests.size());
+							for (size_t i = 0; i < responses.size(); ++i) {
+								json::Writer writer(responses[i], output_, settings_.format);
+								writer.SetDepth(1);
+								reader_.ProcessStatRequest(batch->requests[i].AsMap(), *router_, writer);
+							}
+							{
+								std::lock_guard lock(mutex_);
+								finished_.emplace(batch->seq, std::move(responses));
+							}
+							ready_cv_.notify_all();
+						}
+					}
+					catch (...) {
+						Fail(std::current_exception());
+					}
+				}
+
+				// Consumer: writes responses strictly in request order, flushing whenever it
+				// has to wait so that early responses do not sit in the buffer
+				void EmitResponses(json::Writer& writer) {
+					std::unique_lock lock(mutex_);
+					while (!error_) {
+						if (auto it = finished_.find(emitted_); it != finished_.end()) {
+							const std::vector<std::string> responses = std::move(it->second);
+							finished_.erase(it);
+							++emitted_;
+							lock.unlock();
+							window_cv_.notify_one();
+							for (const std::string& response : responses) {
+								// Requests of unknown type have no response
+								if (!response.empty()) {
+									writer.RawValue(response);
+								}
+							}
+							lock.lock();
+							continue;
+						}
+						if (total_ && emitted_ == *total_) {
+							break;
+						}
+						lock.unlock();
+						writer.Flush();
+						lock.lock();
+						ready_cv_.wait(lock, [this] {
+							return error_ || finished_.count(emitted_) || (total_ && emitted_ == *total_);
+						});
+					}
+				}
+
+				// Keeps the first error and wakes every thread so that they can stop
+				void Fail(std::exception_ptr error) {
+					{
+						std::lock_guard lock(mutex_);
+						if (!error_) {
+							error_ = std::move(error);
+						}
+					}
+					failed_ = true;
+					queue_.Close();
+					ready_cv_.notify_all();
+					window_cv_.notify_all();
+				}
+
+				json::ArrayStream& requests_;
+				const JsonReader& reader_;
+				std::shared_future<void> base_ready_;
+				const std::unique_ptr<JsonReader::Router>& router_;
+				std::ostream& output_;
+				const PipelineSettings& settings_;
+				concurrency::BoundedQueue<StatBatch> queue_;
+
+				std::mutex mutex_;
+				std::condition_variable ready_cv_;
+				std::condition_variable window_cv_;
+				std::unordered_map<size_t, std::vector<std::string>> finished_;
+				size_t emitted_ = 0;
+				std::optional<size_t> total_;
+				std::exception_ptr error_;
+				std::atomic<bool> failed_ = false;
+			};
+
+		} // namespace
+
+		void ProcessRequestsPipelined(std::istream& input, std::ostream& output, const PipelineSettings& settings) {
+			// Only serialization_settings and stat_requests are needed here; the rest is skipped
+			// unparsed. stat_requests are normally last and are parsed straight from the input;
+			// if they come before serialization_settings, their text has to be kept until then
+			json::StreamReader input_reader(input);
+			input_reader.Expect('{');
+			std::string filename;
+			std::optional<std::string> requests_text;
+			bool requests_follow = false;
+			std::string value_text;
+			while (std::optional<std::string> key = input_reader.NextKey()) {
+				if (*key == "serialization_settings"sv) {
+					input_reader.ReadValueText(value_text);
+					const json::Document serialization_settings = json::Load(value_text);
+					filename = serialization_settings.GetRoot().AsMap().at("file"sv).AsString();
+				}
+				else if (*key == "stat_requests"sv && filename.empty()) {
+					requests_text.emplace();
+					input_reader.ReadValueText(*requests_text);
+				}
+				else if (*key == "stat_requests"sv) {
+					requests_text.reset();
+					requests_follow = true;
+					break;
+				}
+				else {
+					input_reader.SkipValue();
+				}
+			}
+			if (filename.empty() || (!requests_text && !requests_follow)) {
+				throw std::out_of_range("serialization_settings and stat_requests are required"s);
+			}
+
+			TransportCatalogue catalogue;
+			JsonReader reader(catalogue);
+			std::unique_ptr<JsonReader::Router> router;
+			std::shared_future<void> base_ready = std::async(std::launch::async, [&] {
+				Deserialize(filename, catalogue);
+				router = std::make_unique<JsonReader::Router>(catalogue.GetGraphConstRef());
+			}).share();
+
+			json::ArrayStream requests = requests_text
+				? json::ArrayStream(*requests_text)
+				: json::ArrayStream(input_reader);
+			StatPipeline pipeline(requests, reader, base_ready, router, output, settings);
+			pipeline.Run();
+			// Reports a broken base even when there were no requests to compute
+			base_ready.get();
+		}
+
+	} // namespace json_handler
+} // namespace transport_catalogue
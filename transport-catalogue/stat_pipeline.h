@@ -0,0 +1,33 @@
+#pragma once
+#include "json_writer.h"
+
+#include <cstddef>
+#include <iostream>
+
+namespace transport_catalogue {
+	namespace json_handler {
+
+		struct PipelineSettings {
+			// 0 means one worker per hardware thread
+			size_t worker_count = 0;
+			// Requests are handed from thread to thread in batches of this size
+			size_t batch_size = 64;
+			// Parsed batches waiting for a worker
+			size_t queue_capacity = 16;
+			// How many batches parsing may run ahead of the last one written out; bounds the
+			// number of finished responses held back while an earlier one is still computed
+			size_t reorder_window = 64;
+			json::Writer::Format format = json::Writer::Format::PRETTY;
+		};
+
+		// process_requests with the phases overlapped: stat requests are read from input in
+		// bounded chunks and parsed batch by batch into a bounded queue while the base is
+		// deserialized and the router is built, workers compute the responses, and the calling
+		// thread writes them out in request order as soon as each is ready. The output is the
+		// same as JsonReader::ProcessStatRequests. input is read from another thread, so it must
+		// not be tied to output
+		void ProcessRequestsPipelined(std::istream& input, std::ostream& output,
+			const PipelineSettings& settings = {});
+
+	} // namespace json_handler
+} // namespace transport_catalogue
@@ -0,0 +1,610 @@
+#include "stat_server.h"
+#include "serialization.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <exception>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace transport_catalogue {
+	namespace json_handler {
+
+		using namespace std::literals;
+
+		namespace {
+			constexpr size_t READ_SIZE = 1 << 16;
+			// Longest base file name a worker can ask the coordinator to reload from
+			constexpr size_t MAX_RELOAD_MESSAGE = 1 << 16;
+			// How often a worker with every connection slot taken looks at its control socket
+			constexpr auto CONTROL_CHECK_PERIOD = std::chrono::milliseconds(100);
+			// How long a retired worker waits for its connections to finish before it exits
+			constexpr auto DRAIN_TIMEOUT = std::chrono::seconds(10);
+
+			std::string_view TrimLine(std::string_view line) {
+				while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+					line.remove_suffix(1);
+				}
+				while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) {
+					line.remove_prefix(1);
+				}
+				return line;
+			}
+
+			// Writes the whole text; false once the peer is gone
+			bool SendAll(int connection, std::string_view text) {
+				while (!text.empty()) {
+					const ssize_t sent = send(connection, text.data(), text.size(), MSG_NOSIGNAL);
+					if (sent < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						return false;
+					}
+					text.remove_prefix(static_cast<size_t>(sent));
+				}
+				return true;
+			}
+
+			class FileDescriptor {
+			public:
+				explicit FileDescriptor(int fd)
+					: fd_(fd) {
+				}
+				FileDescriptor(const FileDescriptor&) = delete;
+				FileDescriptor& operator=(const FileDescriptor&) = delete;
+				~FileDescriptor() {
+					if (fd_ >= 0) {
+						close(fd_);
+					}
+				}
+
+				int Get() const {
+					return fd_;
+				}
+
+			private:
+				int fd_;
+			};
+		}
+
+		BaseSnapshot::BaseSnapshot(std::string base_file, const std::string& router_table)
+			: base_file_(std::move(base_file))
+			, reader_(catalogue_) {
+			Deserialize(base_file_, catalogue_);
+			const auto& graph = catalogue_.GetGraphConstRef();
+			if (!router_table.empty()) {
+				try {
+					router_table_ = std::make_unique<graph::MappedRouterTable>(router_table, graph);
+					router_ = std::make_unique<JsonReader::Router>(graph, router_table_->GetEntries());
+				}
+				catch (const std::exception& e) {
+					std::cerr << "Computing routes instead: "sv << e.what() << '\n';
+				}
+			}
+			if (!router_) {
+				router_ = std::make_unique<JsonReader::Router>(graph);
+			}
+			// Rendered now so that no request pays for the first render
+			catalogue_.GetRenderedMap();
+		}
+
+		StatServer::StatServer(const std::string& base_file, std::string router_table, std::string reload_dir)
+			: snapshot_(std::make_shared<const BaseSnapshot>(base_file, router_table))
+			, router_table_(std::move(router_table))
+			, reload_dir_(std::move(reload_dir)) {
+			number_format_ << std::setprecision(6) << std::fixed;
+		}
+
+		std::shared_ptr<const BaseSnapshot> StatServer::GetSnapshot() const {
+			return std::atomic_load(&snapshot_);
+		}
+
+		void StatServer::Reload(const std::string& base_file) const {
+			std::lock_guard lock(reload_mutex_);
+			if (is_worker_) {
+				ReloadInCoordinator(base_file);
+				return;
+			}
+			// Built before the swap; until then every request sees the old snapshot
+			auto snapshot = std::make_shared<const BaseSnapshot>(base_file, router_table_);
+			std::atomic_store(&snapshot_, std::shared_ptr<const BaseSnapshot>(std::move(snapshot)));
+		}
+
+		void StatServer::ReloadInCoordinator(const std::string& base_file) const {
+			if (base_file.empty() || base_file.size() > MAX_RELOAD_MESSAGE) {
+				throw std::invalid_argument("Cannot reload from "s + base_file);
+			}
+			if (send(control_fd_, base_file.data(), base_file.size(), MSG_NOSIGNAL) < 0) {
+				throw std::system_error(errno, std::generic_category(), "send to the coordinator");
+			}
+			char reloaded = 0;
+			ssize_t received;
+			while ((received = recv(control_fd_, &reloaded, 1, 0)) < 0 && errno == EINTR) {
+			}
+			if (received != 1 || reloaded != 1) {
+				throw std::runtime_error("The coordinator did not reload "s + base_file);
+			}
+			// Everything this worker answers from now on would come from the old base
+			retired_ = true;
+		}
+
+		void StatServer::ProcessReloadRequest(const json::Dict& request, const BaseSnapshot& current,
+			json::Writer& writer) const {
+			const int request_id = request.at("id"sv).AsInt();
+			auto refuse = [&writer, request_id](std::string_view message) {
+				writer.StartDict()
+					.Key("error_message"sv).Value(message)
+					.Key("request_id"sv).Value(request_id)
+					.EndDict();
+			};
+			std::string base_file = current.GetBaseFile();
+			if (const auto file_it = request.find("file"sv); file_it != request.end()) {
+				if (reload_dir_.empty()) {
+					refuse("reload from another file is not enabled"sv);
+					return;
+				}
+				// A bare name, so the file cannot be outside the directory
+				const std::string& file_name = file_it->second.AsString();
+				if (file_name.empty() || file_name == "."sv || file_name == ".."sv
+					|| file_name.find('/') != std::string::npos) {
+					refuse("file must be a file name in the reload directory"sv);
+					return;
+				}
+				base_file = reload_dir_ + '/' + file_name;
+			}
+			writer.StartDict();
+			try {
+				Reload(base_file);
+				writer.Key("request_id"sv).Value(request_id)
+					.Key("status"sv).Value("reloaded"sv);
+			}
+			catch (const std::exception&) {
+				writer.Key("error_message"sv).Value("reload failed"sv)
+					.Key("request_id"sv).Value(request_id);
+			}
+			writer.EndDict();
+		}
+
+		void StatServer::AnswerLine(std::string_view request_line, std::string& response) const {
+			std::optional<json::Document> document;
+			try {
+				document = json::Load(request_line);
+			}
+			catch (const std::exception&) {
+				WriteInvalidRequest(std::nullopt, response);
+				return;
+			}
+			AnswerRequest(document->GetRoot(), response);
+		}
+
+		void StatServer::AnswerRequest(const json::Node& request_node, std::string& response) const {
+			response.clear();
+			std::optional<int> request_id;
+			try {
+				const json::Dict& request = request_node.AsMap();
+				if (const auto it = request.find("id"sv); it != request.end() && it->second.IsInt()) {
+					request_id = it->second.AsInt();
+				}
+				// Held to the end of the request, even if a reload publishes a new one meanwhile
+				const std::shared_ptr<const BaseSnapshot> snapshot = GetSnapshot();
+				json::Writer writer(response, number_format_, json::Writer::Format::COMPACT);
+				if (request.at("type"sv).AsString() == "Reload"sv) {
+					ProcessReloadRequest(request, *snapshot, writer);
+				}
+				else {
+					snapshot->ProcessStatRequest(request, writer);
+				}
+				if (!response.empty()) {
+					return;
+				}
+			}
+			catch (const std::exception&) {
+			}
+			WriteInvalidRequest(request_id, response);
+		}
+
+		void StatServer::WriteInvalidRequest(std::optional<int> request_id, std::string& response) const {
+			response.clear();
+			json::Writer writer(response, number_format_, json::Writer::Format::COMPACT);
+			writer.StartDict().Key("error_message"sv).Value("invalid request"sv);
+			if (request_id) {
+				writer.Key("request_id"sv).Value(*request_id);
+			}
+			writer.EndDict();
+		}
+
+		void StatServer::ServeStream(std::istream& input, std::ostream& output) const {
+			std::string line;
+			std::string response;
+			while (std::getline(input, line)) {
+				const std::string_view request_line = TrimLine(line);
+				if (request_line.empty()) {
+					continue;
+				}
+				AnswerLine(request_line, response);
+				response += '\n';
+				output.write(response.data(), response.size());
+				output.flush();
+			}
+		}
+
+		void StatServer::ServeSocket(const std::string& socket_path, const SocketSettings& settings) const {
+			sockaddr_un address{};
+			if (socket_path.size() >= sizeof(address.sun_path)) {
+				throw std::invalid_argument("Socket path is too long: "s + socket_path);
+			}
+			address.sun_family = AF_UNIX;
+			socket_path.copy(address.sun_path, socket_path.size());
+
+			const FileDescriptor listener(socket(AF_UNIX, SOCK_STREAM, 0));
+			if (listener.Get() < 0) {
+				throw std::system_error(errno, std::generic_category(), "socket");
+			}
+			unlink(socket_path.c_str());
+			if (bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+				throw std::system_error(errno, std::generic_category(), "bind "s + socket_path);
+			}
+			if (listen(listener.Get(), SOMAXCONN) < 0) {
+				throw std::system_error(errno, std::generic_category(), "listen");
+			}
+
+			if (settings.worker_count == 0) {
+				AcceptConnections(listener.Get(), settings);
+			}
+
+			// Workers accept from the shared listener after polling it, and one of them may
+			// take the connection another was woken for
+			if (fcntl(listener.Get(), F_SETFL, fcntl(listener.Get(), F_GETFL) | O_NONBLOCK) < 0) {
+				throw std::system_error(errno, std::generic_category(), "fcntl");
+			}
+			// Child exits and SIGHUP are read from a signalfd, between reload requests
+			sigset_t signals;
+			sigemptyset(&signals);
+			sigaddset(&signals, SIGCHLD);
+			sigaddset(&signals, SIGHUP);
+			sigset_t old_mask;
+			pthread_sigmask(SIG_BLOCK, &signals, &old_mask);
+			const FileDescriptor signal_fd(signalfd(-1, &signals, 0));
+			if (signal_fd.Get() < 0) {
+				throw std::system_error(errno, std::generic_category(), "signalfd");
+			}
+
+			// Each worker reaches the coordinator through its own control socket: it sends
+			// the name of a base file and reads back one byte, 1 if the base was reloaded.
+			// The coordinator shuts the socket down to retire the worker
+			struct Worker {
+				pid_t pid;
+				int control;
+			};
+			std::vector<Worker> workers;
+			const pid_t coordinator = getpid();
+			auto start_worker = [this, &listener, &settings, &signal_fd, &old_mask, &workers, coordinator] {
+				int control[2];
+				if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, control) < 0) {
+					throw std::system_error(errno, std::generic_category(), "socketpair");
+				}
+				const pid_t pid = fork();
+				if (pid < 0) {
+					const int error = errno;
+					close(control[0]);
+					close(control[1]);
+					throw std::system_error(error, std::generic_category(), "fork");
+				}
+				if (pid > 0) {
+					close(control[1]);
+					return Worker{ pid, control[0] };
+				}
+				// Workers go down with the coordinator instead of serving on without it
+				prctl(PR_SET_PDEATHSIG, SIGTERM);
+				if (getppid() != coordinator) {
+					_exit(1);
+				}
+				close(control[0]);
+				for (const Worker& other : workers) {
+					close(other.control);
+				}
+				close(signal_fd.Get());
+				pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+				is_worker_ = true;
+				control_fd_ = control[1];
+				try {
+					AcceptConnections(listener.Get(), settings);
+					_exit(0);
+				}
+				catch (const std::exception& e) {
+					std::cerr << "Worker "sv << getpid() << ": "sv << e.what() << '\n';
+				}
+				_exit(1);
+			};
+
+			// The new base is loaded here and a new set of workers is forked from it before the
+			// old workers are retired, so there is no moment without workers to serve. Returns
+			// the old workers, which are forgotten once retired: they exit on their own when drained
+			auto reload_workers = [this, &workers, &start_worker, &settings](const std::string& base_file)
+				-> std::optional<std::vector<Worker>> {
+				try {
+					Reload(base_file);
+				}
+				catch (const std::exception& e) {
+					std::cerr << "Reload from "sv << base_file << " failed: "sv << e.what() << '\n';
+					return std::nullopt;
+				}
+				const size_t old_count = workers.size();
+				for (size_t i = 0; i < settings.worker_count; ++i) {
+					workers.push_back(start_worker());
+				}
+				std::vector<Worker> old_workers(workers.begin(), workers.begin() + old_count);
+				workers.erase(workers.begin(), workers.begin() + old_count);
+				return old_workers;
+			};
+			auto retire = [](const std::optional<std::vector<Worker>>& old_workers) {
+				for (const Worker& worker : old_workers.value_or(std::vector<Worker>())) {
+					if (worker.control >= 0) {
+						shutdown(worker.control, SHUT_RDWR);
+						close(worker.control);
+					}
+				}
+			};
+
+			for (size_t i = 0; i < settings.worker_count; ++i) {
+				workers.push_back(start_worker());
+			}
+			std::vector<pollfd> poll_fds;
+			std::string message(MAX_RELOAD_MESSAGE, '\0');
+			while (true) {
+				poll_fds.assign(1, pollfd{ signal_fd.Get(), POLLIN, 0 });
+				for (const Worker& worker : workers) {
+					poll_fds.push_back({ worker.control, POLLIN, 0 });
+				}
+				if (poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					throw std::system_error(errno, std::generic_category(), "poll");
+				}
+
+				if (poll_fds[0].revents & POLLIN) {
+					signalfd_siginfo signal_info;
+					if (read(signal_fd.Get(), &signal_info, sizeof(signal_info)) != sizeof(signal_info)) {
+						continue;
+					}
+					if (signal_info.ssi_signo == SIGHUP) {
+						retire(reload_workers(GetSnapshot()->GetBaseFile()));
+						continue;
+					}
+					// Signals of the same kind merge, so every exited child is collected
+					int status = 0;
+					for (pid_t pid; (pid = waitpid(-1, &status, WNOHANG)) > 0;) {
+						for (Worker& worker : workers) {
+							if (worker.pid == pid) {
+								if (worker.control >= 0) {
+									close(worker.control);
+								}
+								// Not at once, so that a worker failing on start does not spin the loop
+								std::this_thread::sleep_for(std::chrono::milliseconds(100));
+								worker = start_worker();
+							}
+						}
+					}
+					continue;
+				}
+
+				// One request per pass, as a reload replaces the workers
+				for (size_t i = 1; i < poll_fds.size(); ++i) {
+					if (poll_fds[i].revents == 0) {
+						continue;
+					}
+					const int control = poll_fds[i].fd;
+					const ssize_t size = recv(control, message.data(), message.size(), 0);
+					if (size <= 0) {
+						// The worker is gone; it is replaced once it is collected
+						for (Worker& worker : workers) {
+							if (worker.control == control) {
+								close(worker.control);
+								worker.control = -1;
+							}
+						}
+						break;
+					}
+					const std::optional<std::vector<Worker>> old_workers =
+						reload_workers(message.substr(0, static_cast<size_t>(size)));
+					const char reloaded = old_workers ? 1 : 0;
+					send(control, &reloaded, 1, MSG_NOSIGNAL);
+					retire(old_workers);
+					break;
+				}
+			}
+		}
+
+		void StatServer::AcceptConnections(int listener, const SocketSettings& settings) const {
+			// Made here, as worker processes must start their threads after the fork
+			std::unique_ptr<concurrency::RequestScheduler> scheduler;
+			if (settings.scheduled) {
+				scheduler = std::make_unique<concurrency::RequestScheduler>(
+					MakeRequestClasses(settings.thread_count), settings.thread_count);
+			}
+			// Shared with the connection threads, which may outlive this function
+			struct Connections {
+				std::mutex mutex;
+				std::condition_variable released;
+				std::unordered_set<int> open;
+			};
+			const auto connections = std::make_shared<Connections>();
+			const size_t max_connections = std::max<size_t>(settings.max_connections, 1);
+			while (true) {
+				bool has_slot = false;
+				{
+					// Woken now and then, so that a worker with every slot taken still notices
+					// being retired
+					std::unique_lock lock(connections->mutex);
+					has_slot = connections->released.wait_for(lock, CONTROL_CHECK_PERIOD,
+						[&connections, max_connections] { return connections->open.size() < max_connections; });
+				}
+				if (is_worker_) {
+					// A connection to accept, or the coordinator shutting the control socket down
+					pollfd fds[] = { { has_slot ? listener : -1, POLLIN, 0 }, { control_fd_, POLLRDHUP, 0 } };
+					if (poll(fds, std::size(fds), has_slot ? -1 : 0) < 0 && errno != EINTR) {
+						throw std::system_error(errno, std::generic_category(), "poll");
+					}
+					if (fds[1].revents != 0) {
+						break;
+					}
+				}
+				if (!has_slot) {
+					continue;
+				}
+				const int connection = accept(listener, nullptr, nullptr);
+				if (connection < 0) {
+					if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN || errno == EWOULDBLOCK) {
+						continue;
+					}
+					throw std::system_error(errno, std::generic_category(), "accept");
+				}
+				{
+					std::lock_guard lock(connections->mutex);
+					connections->open.insert(connection);
+				}
+				std::thread([this, connection, connections, max_line_size = settings.max_line_size,
+					scheduler = scheduler.get()] {
+					{
+						// Closed only after leaving the set, so that its number is not reused meanwhile
+						const FileDescriptor guard(connection);
+						ServeConnection(connection, max_line_size, scheduler);
+						std::lock_guard lock(connections->mutex);
+						connections->open.erase(connection);
+					}
+					connections->released.notify_all();
+				}).detach();
+			}
+
+			// Retired: the connections finish the requests they are answering and close
+			// instead of reading more; reads that are waiting are woken by the shutdown
+			retired_ = true;
+			std::unique_lock lock(connections->mutex);
+			for (const int connection : connections->open) {
+				shutdown(connection, SHUT_RD);
+			}
+			if (!connections->released.wait_for(lock, DRAIN_TIMEOUT, [&connections] { return connections->open.empty(); })) {
+				// Still used by the connections that did not finish; the worker exits without it
+				scheduler.release();
+			}
+		}
+
+		void StatServer::ServeConnection(int connection, size_t max_line_size,
+			concurrency::RequestScheduler* scheduler) const {
+			std::string pending;
+			std::string responses;
+			std::string response;
+			std::vector<std::string_view> request_lines;
+			std::vector<std::optional<json::Document>> documents;
+			std::vector<std::string> scheduled_responses;
+			char chunk[READ_SIZE];
+			try {
+				while (true) {
+					const ssize_t received = recv(connection, chunk, sizeof(chunk), 0);
+					if (received < 0 && errno == EINTR) {
+						continue;
+					}
+					// A retired worker's base is out of date: what was not answered yet is dropped
+					// with the connection, and the client reconnects to a current worker
+					if (received <= 0 || retired_) {
+						return;
+					}
+					pending.append(chunk, static_cast<size_t>(received));
+
+					request_lines.clear();
+					size_t line_begin = 0;
+					bool line_too_long = false;
+					for (size_t line_end = pending.find('\n'); line_end != std::string::npos;
+						line_end = pending.find('\n', line_begin)) {
+						if (line_end - line_begin > max_line_size) {
+							line_too_long = true;
+							break;
+						}
+						const std::string_view request_line =
+							TrimLine(std::string_view(pending).substr(line_begin, line_end - line_begin));
+						line_begin = line_end + 1;
+						if (!request_line.empty()) {
+							request_lines.push_back(request_line);
+						}
+					}
+
+					// Requests that arrived together are answered with a single send
+					if (scheduler) {
+						documents.clear();
+						documents.resize(request_lines.size());
+						scheduled_responses.resize(request_lines.size());
+						concurrency::TaskGroup group(*scheduler);
+						for (size_t i = 0; i < request_lines.size(); ++i) {
+							try {
+								documents[i] = json::Load(request_lines[i]);
+							}
+							catch (const std::exception&) {
+								WriteInvalidRequest(std::nullopt, scheduled_responses[i]);
+								continue;
+							}
+							const json::Node& request = documents[i]->GetRoot();
+							group.Submit(static_cast<size_t>(GetRequestType(request)), [this, &request, &scheduled_responses, i] {
+								AnswerRequest(request, scheduled_responses[i]);
+							});
+						}
+						group.Wait();
+						for (size_t i = 0; i < request_lines.size(); ++i) {
+							responses += scheduled_responses[i];
+							responses += '\n';
+						}
+					}
+					else {
+						for (const std::string_view request_line : request_lines) {
+							if (retired_) {
+								break;
+							}
+							AnswerLine(request_line, response);
+							responses += response;
+							responses += '\n';
+						}
+					}
+					pending.erase(0, line_begin);
+					// The rest of the line is not read: the connection is closed after the answer
+					if (line_too_long || pending.size() > max_line_size) {
+						WriteInvalidRequest(std::nullopt, response);
+						responses += response;
+						responses += '\n';
+						SendAll(connection, responses);
+						return;
+					}
+					if (!SendAll(connection, responses) || retired_) {
+						return;
+					}
+					responses.clear();
+				}
+			}
+			catch (const std::exception&) {
+				// Out of memory and the like: only this connection is dropped
+			}
+		}
+
+	} // namespace json_handler
+} // namespace transport_catalogue
@@ -0,0 +1,141 @@
+#pragma once
+#include "json_reader.h"
+#include "router_table.h"
+#include "transport_catalogue.h"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace transport_catalogue {
+	namespace json_handler {
+
+		// A loaded base with everything requests are answered from: the catalogue with its
+		// settings and caches, and the router. Built whole, then only read.
+		// With a router table written by make_base for this base, the router answers from
+		// the mapped file instead of computing its own table; a table that does not match
+		// the base is ignored
+		class BaseSnapshot {
+		public:
+			explicit BaseSnapshot(std::string base_file, const std::string& router_table = {});
+			BaseSnapshot(const BaseSnapshot&) = delete;
+			BaseSnapshot& operator=(const BaseSnapshot&) = delete;
+
+			const std::string& GetBaseFile() const {
+				return base_file_;
+			}
+
+			// Safe to call from several threads at once
+			void ProcessStatRequest(const json::Dict& request, json::Writer& writer) const {
+				reader_.ProcessStatRequest(request, *router_, writer);
+			}
+			// The response to a whole stat_requests array, as process_requests writes it
+			void ProcessStatRequests(const json::Array& requests, std::ostream& output) const {
+				reader_.ProcessStatRequests(requests, *router_, output);
+			}
+
+		private:
+			std::string base_file_;
+			TransportCatalogue catalogue_;
+			JsonReader reader_;
+			std::unique_ptr<graph::MappedRouterTable> router_table_;
+			std::unique_ptr<JsonReader::Router> router_;
+		};
+
+		// Keeps a base resident and answers stat requests written one JSON object per line.
+		// Every non-empty request line gets exactly one response line of compact JSON, in
+		// request order; a line that cannot be answered gets {"error_message": ...} instead.
+		//
+		// {"id": N, "type": "Reload"} loads the base again. A request may name another base
+		// with "file" only if the server was given a reload directory, and then only by a
+		// plain file name inside it; no request can make the server read any other path.
+		// The new snapshot is built while the old one keeps serving and is published
+		// with an atomic pointer swap; requests already running finish on the old snapshot,
+		// which is freed when the last of them is done
+		struct SocketSettings {
+			// Worker processes; 0 serves from this process
+			size_t worker_count = 0;
+			// Answer the requests of every connection on one RequestScheduler per process,
+			// cheap types first, instead of on the connection's own thread
+			bool scheduled = false;
+			// Scheduler threads; 0 means one per hardware thread
+			size_t thread_count = 0;
+			// Connections served at once by each process; more wait in the listen backlog
+			size_t max_connections = 256;
+			// A longer request line is answered with invalid request and its connection closed
+			size_t max_line_size = 1 << 20;
+		};
+
+		class StatServer {
+		public:
+			// Reload requests with a "file" are refused without reload_dir
+			explicit StatServer(const std::string& base_file, std::string router_table = {},
+				std::string reload_dir = {});
+			StatServer(const StatServer&) = delete;
+			StatServer& operator=(const StatServer&) = delete;
+
+			// Replaces response with the answer to one request line, without the newline.
+			// Safe to call from several threads at once
+			void AnswerLine(std::string_view request_line, std::string& response) const;
+
+			// Answers lines from input until it ends, flushing after every response
+			void ServeStream(std::istream& input, std::ostream& output) const;
+			// Listens on a Unix domain socket, replacing any file at path, and serves every
+			// connection on its own thread. Returns only by throwing.
+			// With scheduling, requests that arrive together on a connection are queued at
+			// once and answered in parallel, still in request order.
+			// With worker_count > 0 this process only listens: it forks that many workers,
+			// which accept connections from the shared socket, and starts a new one whenever
+			// one dies. The workers share the pages of the loaded base with this process and
+			// each other as long as nobody writes them, and the router table through its
+			// mapped file. A Reload request received by a worker, or SIGHUP, which reloads the
+			// current base file, makes this process load the base and fork a new set of workers
+			// from it. Then the old workers are retired: they stop accepting, finish the
+			// requests they are answering and close their connections, dropping requests that
+			// were not answered yet, and clients reconnect to the new workers.
+			// Must be called before the process starts any other thread
+			void ServeSocket(const std::string& socket_path, const SocketSettings& settings = {}) const;
+
+			// Loads a base and makes it current; throws, leaving the current one, on failure.
+			// In a worker the coordinator does it, and the worker is retired on success
+			void Reload(const std::string& base_file) const;
+
+			std::shared_ptr<const BaseSnapshot> GetSnapshot() const;
+
+		private:
+			// In a worker, returns once the worker is retired and its connections are closed
+			void AcceptConnections(int listener, const SocketSettings& settings) const;
+			// Without a scheduler the requests are answered on the calling thread
+			void ServeConnection(int connection, size_t max_line_size,
+				concurrency::RequestScheduler* scheduler) const;
+			// The rest of AnswerLine, once the line is parsed
+			void AnswerRequest(const json::Node& request_node, std::string& response) const;
+			void WriteInvalidRequest(std::optional<int> request_id, std::string& response) const;
+			void ProcessReloadRequest(const json::Dict& request, const BaseSnapshot& current,
+				json::Writer& writer) const;
+			// Asks the coordinator to reload from base_file, with reload_mutex_ held
+			void ReloadInCoordinator(const std::string& base_file) const;
+
+			// Read and replaced only through std::atomic_load and std::atomic_store
+			mutable std::shared_ptr<const BaseSnapshot> snapshot_;
+			// One reload at a time, so an older base cannot be published over a newer one
+			mutable std::mutex reload_mutex_;
+			std::string router_table_;
+			std::string reload_dir_;
+			// Set in worker processes, before they start any thread
+			mutable bool is_worker_ = false;
+			// A worker's end of its control socket to the coordinator
+			mutable int control_fd_ = -1;
+			// Set once a worker's base is replaced; it answers no more requests
+			mutable std::atomic<bool> retired_ = false;
+			// Number formatting of responses, as process_requests sets up its output
+			std::ostringstream number_format_;
+		};
+
+	} // namespace json_handler
+} // namespace transport_catalogue
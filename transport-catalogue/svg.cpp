@@ -1,5 +1,7 @@
 #include "svg.h"
 
+#include <charconv>
+
 namespace svg {
 
     using namespace std::literals;
@@ -76,10 +78,11 @@ namespace svg {
     void Object::Render(const RenderContext& context) const {
         context.RenderIndent();
 
-        //     
+        // Делегируем вывод тега своим подклассам
         RenderObject(context);
 
-        context.out << std::endl;
+        // No std::endl: flushing after every element is what made big maps slow
+        context.out << '\n';
     }
 
     // ---------- Circle ------------------
@@ -98,7 +101,7 @@ namespace svg {
         auto& out = context.out;
         out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
         out << "r=\""sv << radius_ << "\""sv;
-        //  ,   PathProps
+        // Выводим атрибуты, унаследованные от PathProps
         RenderAttrs(context.out);
         out << "/>"sv;
     }
@@ -154,7 +157,7 @@ namespace svg {
     }
 
     Text& Text::SetData(std::string data) {
-        data_ = data;
+        data_ = std::move(data);
         CleanUpString(data_);
         return *this;
     }
@@ -177,34 +180,10 @@ namespace svg {
     }
 
     void Text::CleanUpString(std::string& data) const {
-        size_t pos = 0;
-
-        while ((pos = data.find('&', pos + 1)) != data.npos) {
-            data.insert(pos + 1, "&amp;");
-            data.erase(pos, 1);
-        }
-
-        while ((pos = data.find_first_of(R"("'<>)")) != data.npos) {
-            switch (data[pos])
-            {
-            case ('\"'):
-                data.insert(pos + 1, "&quot;");
-                break;
-
-            case ('\''):
-                data.insert(pos + 1, "&apos;");
-                break;
-
-            case ('<'):
-                data.insert(pos + 1, "&lt;");
-                break;
-
-            case ('>'):
-                data.insert(pos + 1, "&gt;");
-                break;
-            }
-            data.erase(pos, 1);
-        }
+        std::string escaped;
+        escaped.reserve(data.size());
+        detail::AppendEscapedText(escaped, data);
+        data = std::move(escaped);
     }
 
     // ---------- Document -----------------
@@ -222,4 +201,253 @@ namespace svg {
         out << "</svg>";
     }
 
+    // ---------- Writer -------------------
+
+    namespace detail {
+        void AppendEscapedText(std::string& out, std::string_view text) {
+            size_t run_begin = 0;
+            for (size_t i = 0; i < text.size(); ++i) {
+                std::string_view entity;
+                switch (text[i]) {
+                case '&':
+                    if (i != 0) {
+                        entity = "&amp;"sv;
+                    }
+                    break;
+                case '"':
+                    entity = "&quot;"sv;
+                    break;
+                case '\'':
+                    entity = "&apos;"sv;
+                    break;
+                case '<':
+                    entity = "&lt;"sv;
+                    break;
+                case '>':
+                    entity = "&gt;"sv;
+                    break;
+                }
+                if (!entity.empty()) {
+                    out.append(text.substr(run_begin, i - run_begin));
+                    out.append(entity);
+                    run_begin = i + 1;
+                }
+            }
+            out.append(text.substr(run_begin));
+        }
+    } // namespace detail
+
+    Writer::Writer(std::string& output)
+        : output_(output) {
+    }
+
+    Writer::Writer(std::string& buffer, ChunkSink sink, size_t chunk_size)
+        : output_(buffer)
+        , sink_(std::move(sink))
+        , chunk_size_(chunk_size) {
+        output_.reserve(chunk_size_ + chunk_size_ / 8);
+    }
+
+    void Writer::Flush() {
+        if (sink_ && !output_.empty()) {
+            sink_(output_);
+            output_.clear();
+        }
+    }
+
+    void Writer::RawMarkup(std::string_view markup) {
+        if (sink_ && markup.size() >= chunk_size_) {
+            // Large pieces go to the sink as they are instead of through the buffer
+            Flush();
+            sink_(markup);
+            return;
+        }
+        Append(markup);
+        FlushIfFull();
+    }
+
+    void Writer::StartDocument() {
+        Append("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv);
+        Append("<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv);
+    }
+
+    void Writer::StartDocument(double width, double height) {
+        Append("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv);
+        Append("<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\""sv);
+        AppendNumber(width);
+        Append("\" height=\""sv);
+        AppendNumber(height);
+        Append("\" viewBox=\"0 0 "sv);
+        AppendNumber(width);
+        Append(" "sv);
+        AppendNumber(height);
+        Append("\">\n"sv);
+    }
+
+    void Writer::EndDocument() {
+        Append("</svg>"sv);
+    }
+
+    void Writer::Circle(Point center, double radius, const PathAttrs& attrs) {
+        Append("  <circle cx=\""sv);
+        AppendNumber(center.x);
+        Append("\" cy=\""sv);
+        AppendNumber(center.y);
+        Append("\" r=\""sv);
+        AppendNumber(radius);
+        Append("\""sv);
+        AppendAttrs(attrs);
+        Append("/>\n"sv);
+        FlushIfFull();
+    }
+
+    void Writer::StartPolyline() {
+        Append("  <polyline points=\""sv);
+        first_point_ = true;
+    }
+
+    void Writer::AddPoint(Point point) {
+        if (!first_point_) {
+            Append(" "sv);
+        }
+        first_point_ = false;
+        AppendNumber(point.x);
+        Append(","sv);
+        AppendNumber(point.y);
+        // Inside the points attribute, but the sink sees only a stream of bytes
+        FlushIfFull();
+    }
+
+    void Writer::EndPolyline(const PathAttrs& attrs) {
+        Append("\""sv);
+        AppendAttrs(attrs);
+        Append("/>\n"sv);
+        FlushIfFull();
+    }
+
+    void Writer::Text(const TextAttrs& text, const PathAttrs& attrs) {
+        Append("  <text"sv);
+        AppendAttrs(attrs);
+        if (!text.font_family.empty()) {
+            Append(" font-family=\""sv);
+            Append(text.font_family);
+            Append("\""sv);
+        }
+        if (!text.font_weight.empty()) {
+            Append(" font-weight=\""sv);
+            Append(text.font_weight);
+            Append("\""sv);
+        }
+        Append(" x=\""sv);
+        AppendNumber(text.position.x);
+        Append("\" y=\""sv);
+        AppendNumber(text.position.y);
+        Append("\" dx=\""sv);
+        AppendNumber(text.offset.x);
+        Append("\" dy=\""sv);
+        AppendNumber(text.offset.y);
+        Append("\" font-size=\""sv);
+        AppendNumber(text.font_size);
+        Append("\">"sv);
+        detail::AppendEscapedText(output_, text.data);
+        Append("</text>\n"sv);
+        FlushIfFull();
+    }
+
+    void Writer::AppendNumber(double value) {
+        // The general format with precision 6 is what operator<< uses on a fresh stream
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+        output_.append(digits, result.ptr);
+    }
+
+    void Writer::AppendNumber(uint32_t value) {
+        char digits[16];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        output_.append(digits, result.ptr);
+    }
+
+    void Writer::AppendColor(const Color& color) {
+        if (const std::string* name = std::get_if<std::string>(&color)) {
+            Append(*name);
+        }
+        else if (const Rgba* rgba = std::get_if<Rgba>(&color)) {
+            Append("rgba("sv);
+            AppendNumber(uint32_t{ rgba->red });
+            Append(","sv);
+            AppendNumber(uint32_t{ rgba->green });
+            Append(","sv);
+            AppendNumber(uint32_t{ rgba->blue });
+            Append(","sv);
+            AppendNumber(rgba->opacity);
+            Append(")"sv);
+        }
+        else if (const Rgb* rgb = std::get_if<Rgb>(&color)) {
+            Append("rgb("sv);
+            AppendNumber(uint32_t{ rgb->red });
+            Append(","sv);
+            AppendNumber(uint32_t{ rgb->green });
+            Append(","sv);
+            AppendNumber(uint32_t{ rgb->blue });
+            Append(")"sv);
+        }
+        else {
+            Append("none"sv);
+        }
+    }
+
+    void Writer::AppendAttrs(const PathAttrs& attrs) {
+        if (attrs.fill_color) {
+            Append(" fill=\""sv);
+            AppendColor(*attrs.fill_color);
+            Append("\""sv);
+        }
+        if (attrs.stroke_color) {
+            Append(" stroke=\""sv);
+            AppendColor(*attrs.stroke_color);
+            Append("\""sv);
+        }
+        if (attrs.stroke_width) {
+            Append(" stroke-width=\""sv);
+            AppendNumber(*attrs.stroke_width);
+            Append("\""sv);
+        }
+        if (attrs.line_cap) {
+            Append(" stroke-linecap=\""sv);
+            switch (*attrs.line_cap) {
+            case StrokeLineCap::BUTT:
+                Append("butt"sv);
+                break;
+            case StrokeLineCap::ROUND:
+                Append("round"sv);
+                break;
+            case StrokeLineCap::SQUARE:
+                Append("square"sv);
+                break;
+            }
+            Append("\""sv);
+        }
+        if (attrs.line_join) {
+            Append(" stroke-linejoin=\""sv);
+            switch (*attrs.line_join) {
+            case StrokeLineJoin::ARCS:
+                Append("arcs"sv);
+                break;
+            case StrokeLineJoin::BEVEL:
+                Append("bevel"sv);
+                break;
+            case StrokeLineJoin::MITER:
+                Append("miter"sv);
+                break;
+            case StrokeLineJoin::MITER_CLIP:
+                Append("miter-clip"sv);
+                break;
+            case StrokeLineJoin::ROUND:
+                Append("round"sv);
+                break;
+            }
+            Append("\""sv);
+        }
+    }
+
 }  // namespace svg
\ No newline at end of file
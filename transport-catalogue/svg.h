@@ -1,11 +1,13 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 #include <optional>
+#include <string_view>
 #include <variant>
 
 namespace svg {
@@ -40,20 +42,20 @@ namespace svg {
         void operator()(Rgba rgba) const;
     };
 
-    //        inline,
-    //   ,        ,
-    //    .
-    //            
+    // Объявив в заголовочном файле константу со спецификатором inline,
+    // мы сделаем так, что она будет одной на все единицы трансляции,
+    // которые подключают этот заголовок.
+    // В противном случае каждая единица трансляции будет использовать свою копию этой константы
     inline const Color NoneColor{ "none" };
 
-    //    
+    // Тип формы конца линии
     enum class StrokeLineCap {
         BUTT,
         ROUND,
         SQUARE,
     };
 
-    //    
+    // Тип формы соединения линий
     enum class StrokeLineJoin {
         ARCS,
         BEVEL,
@@ -116,8 +118,8 @@ namespace svg {
 
     private:
         Owner& AsOwner() {
-            // static_cast   *this  Owner&,
-            //   Owner   PathProps
+            // static_cast безопасно преобразует *this к Owner&,
+            // если класс Owner — наследник PathProps
             return static_cast<Owner&>(*this);
         }
 
@@ -141,8 +143,8 @@ namespace svg {
     };
 
     /*
-     *  ,     SVG-  .
-     *     ,        
+     * Вспомогательная структура, хранящая контекст для вывода SVG-документа с отступами.
+     * Хранит ссылку на поток вывода, текущее значение и шаг отступа при выводе элемента
      */
     struct RenderContext {
         RenderContext(std::ostream& out)
@@ -171,9 +173,9 @@ namespace svg {
     };
 
     /*
-     *    Object    
-     *   SVG-
-     *   " "    
+     * Абстрактный базовый класс Object служит для унифицированного хранения
+     * конкретных тегов SVG-документа
+     * Реализует паттерн "Шаблонный метод" для вывода содержимого тега
      */
     class Object {
     public:
@@ -187,9 +189,9 @@ namespace svg {
 
 
     /*
-        ()     SVG-.
-         Drawable-   , 
-        SVG-.
+      Абстрактный класс (интерфейс) для доступа к контейнеру SVG-объектов.
+      Через этот интерфейс Drawable-объекты могут визуализировать себя, добавляя
+      в контейнер SVG-примитивы.
     */
     class ObjectContainer {
     public:
@@ -204,9 +206,9 @@ namespace svg {
     };
 
     /*
-      .    ,   ,
-       SVG-.       Draw, 
-         ObjectContainer
+      Интерфейс. Унифицирует работу с объектами, которые можно нарисовать,
+      подключив SVG-библиотеку. Для этого в нем есть метод Draw, принимающий
+      ссылку на интерфейс ObjectContainer
     */
     class Drawable {
     public:
@@ -217,7 +219,7 @@ namespace svg {
 
 
     /*
-    *  Circle   <circle>   
+    * Класс Circle моделирует элемент <circle> для отображения круга
     * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/circle
     */
     class Circle final : public Object, public PathProps<Circle> {
@@ -234,16 +236,16 @@ namespace svg {
 
 
     /*
-     *  Polyline   <polyline>    
+     * Класс Polyline моделирует элемент <polyline> для отображения ломаных линий
      * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/polyline
      */
     class Polyline : public Object, public PathProps<Polyline> {
     public:
-        //      
+        // Добавляет очередную вершину к ломаной линии
         Polyline& AddPoint(Point point);
 
         /*
-         *    ,     <polyline>
+         * Прочие методы и данные, необходимые для реализации элемента <polyline>
          */
     private:
         void RenderObject(const RenderContext& context) const override;
@@ -252,30 +254,30 @@ namespace svg {
     };
 
     /*
-     *  Text   <text>   
+     * Класс Text моделирует элемент <text> для отображения текста
      * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/text
      */
     class Text : public Object, public PathProps<Text> {
     public:
-        //     ( x  y)
+        // Задаёт координаты опорной точки (атрибуты x и y)
         Text& SetPosition(Point pos);
 
-        //      ( dx, dy)
+        // Задаёт смещение относительно опорной точки (атрибуты dx, dy)
         Text& SetOffset(Point offset);
 
-        //    ( font-size)
+        // Задаёт размеры шрифта (атрибут font-size)
         Text& SetFontSize(uint32_t size);
 
-        //    ( font-family)
+        // Задаёт название шрифта (атрибут font-family)
         Text& SetFontFamily(std::string font_family);
 
-        //    ( font-weight)
+        // Задаёт толщину шрифта (атрибут font-weight)
         Text& SetFontWeight(std::string font_weight);
 
-        //     (   text)
+        // Задаёт текстовое содержимое объекта (отображается внутри тега text)
         Text& SetData(std::string data);
 
-        //    ,     <text>
+        // Прочие данные и методы, необходимые для реализации элемента <text>
     private:
         void RenderObject(const RenderContext& context) const override;
         void CleanUpString(std::string& data) const;
@@ -291,8 +293,8 @@ namespace svg {
     class Document : public ObjectContainer {
     public:
         /*
-          Add   svg-  - svg::Object.
-          :
+         Метод Add добавляет в svg-документ любой объект-наследник svg::Object.
+         Пример использования:
          Document doc;
          doc.Add(Circle().SetCenter({20, 30}).SetRadius(15));
         */
@@ -300,13 +302,13 @@ namespace svg {
         //template <typename Obj>
         //void Add(Obj obj);
 
-        //   svg- - svg::Object
+        // Добавляет в svg-документ объект-наследник svg::Object
         void AddPtr(std::unique_ptr<Object>&& obj) override;
 
-        //   ostream svg- 
+        // Выводит в ostream svg-представление документа
         void Render(std::ostream& out) const;
 
-        //    ,     Document
+        // Прочие методы и данные, необходимые для реализации класса Document
     private:
         std::vector<std::unique_ptr<Object>> objects_;
     };
@@ -316,4 +318,89 @@ namespace svg {
     //    objects_.emplace_back(std::make_unique<Obj>(std::move(obj)));
     //}
 
+    namespace detail {
+        // Appends text with the XML special characters replaced by entities, in one pass.
+        // An '&' in the very first position is left as is, like Text always did
+        void AppendEscapedText(std::string& out, std::string_view text);
+    } // namespace detail
+
+    // Presentation attributes written by Writer; unset ones are omitted.
+    // Colors are referenced, not copied, and must outlive the call
+    struct PathAttrs {
+        const Color* fill_color = nullptr;
+        const Color* stroke_color = nullptr;
+        std::optional<double> stroke_width;
+        std::optional<StrokeLineCap> line_cap;
+        std::optional<StrokeLineJoin> line_join;
+    };
+
+    struct TextAttrs {
+        Point position;
+        Point offset;
+        uint32_t font_size = 1;
+        std::string_view font_family;
+        std::string_view font_weight;
+        // Raw text; escaped while written
+        std::string_view data;
+    };
+
+    /*
+     * Streams SVG markup straight into a string, element by element, with no object tree.
+     * Produces the same text as Document::Render with the same objects: numbers are
+     * formatted with to_chars as a default-configured ostream would print them
+     */
+    class Writer {
+    public:
+        // Receives the markup chunk by chunk, in order
+        using ChunkSink = std::function<void(std::string_view)>;
+
+        static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
+        explicit Writer(std::string& output);
+        // Uses buffer only as scratch space: once it holds chunk_size bytes, it is handed to
+        // sink and cleared. That happens after an element or, within a polyline, after a
+        // point, so a chunk may end in the middle of an element. Call Flush when done
+        Writer(std::string& buffer, ChunkSink sink, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+        void StartDocument();
+        // A document of the given size in pixels, which viewers crop its content to
+        void StartDocument(double width, double height);
+        void EndDocument();
+
+        void Circle(Point center, double radius, const PathAttrs& attrs);
+
+        // A polyline is streamed point by point; its attributes follow the points in the markup
+        void StartPolyline();
+        void AddPoint(Point point);
+        void EndPolyline(const PathAttrs& attrs);
+
+        void Text(const TextAttrs& text, const PathAttrs& attrs);
+
+        // Inserts elements already written by another Writer, e.g. a part of the
+        // document rendered on another thread
+        void RawMarkup(std::string_view markup);
+
+        // Hands whatever is buffered to the sink; does nothing without one
+        void Flush();
+
+    private:
+        void Append(std::string_view text) {
+            output_.append(text);
+        }
+        void FlushIfFull() {
+            if (sink_ && output_.size() >= chunk_size_) {
+                Flush();
+            }
+        }
+        void AppendNumber(double value);
+        void AppendNumber(uint32_t value);
+        void AppendColor(const Color& color);
+        void AppendAttrs(const PathAttrs& attrs);
+
+        std::string& output_;
+        ChunkSink sink_;
+        size_t chunk_size_ = 0;
+        bool first_point_ = true;
+    };
+
 }  // namespace svg
\ No newline at end of file
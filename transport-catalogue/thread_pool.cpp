@@ -0,0 +1,141 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace concurrency {
+
+    WorkStealingPool::WorkStealingPool(size_t thread_count) {
+        if (thread_count == 0) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        queues_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            queues_.push_back(std::make_unique<WorkerQueue>());
+        }
+        threads_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            threads_.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool() {
+        {
+            std::lock_guard lock(wake_mutex_);
+            stop_ = true;
+        }
+        wake_cv_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void WorkStealingPool::ParallelFor(size_t count, size_t grain,
+                                       const std::function<void(size_t, size_t)>& body) {
+        if (count == 0) {
+            return;
+        }
+        grain = std::max<size_t>(grain, 1);
+        const size_t chunk_count = (count + grain - 1) / grain;
+
+        struct Group {
+            std::atomic<size_t> remaining;
+            std::mutex mutex;
+            std::condition_variable done;
+            std::exception_ptr error;
+        } group;
+        group.remaining = chunk_count;
+
+        // Neighbouring chunks go to the same queue, so a worker keeps to one part of the
+        // range until it runs dry and starts stealing
+        const size_t queue_count = queues_.size();
+        // Raised before any task can be taken, so it never drops below zero
+        pending_ += chunk_count;
+        for (size_t q = 0; q < queue_count; ++q) {
+            const size_t first = chunk_count * q / queue_count;
+            const size_t last = chunk_count * (q + 1) / queue_count;
+            if (first == last) {
+                continue;
+            }
+            std::lock_guard lock(queues_[q]->mutex);
+            for (size_t chunk = first; chunk < last; ++chunk) {
+                queues_[q]->tasks.emplace_back([&group, &body, chunk, grain, count] {
+                    try {
+                        const size_t begin = chunk * grain;
+                        body(begin, std::min(begin + grain, count));
+                    }
+                    catch (...) {
+                        std::lock_guard lock(group.mutex);
+                        if (!group.error) {
+                            group.error = std::current_exception();
+                        }
+                    }
+                    // Counted down under the mutex so the caller cannot return and destroy
+                    // the group while the last task is still touching it
+                    std::lock_guard lock(group.mutex);
+                    if (--group.remaining == 0) {
+                        group.done.notify_all();
+                    }
+                });
+            }
+        }
+        {
+            // A worker between its pending_ check and wait() holds the mutex, so it
+            // cannot miss this notification
+            std::lock_guard lock(wake_mutex_);
+        }
+        wake_cv_.notify_all();
+
+        // The caller has no queue of its own and only steals
+        while (group.remaining > 0 && TryRunOne(queue_count)) {
+        }
+        std::unique_lock lock(group.mutex);
+        group.done.wait(lock, [&group] {
+            return group.remaining == 0;
+        });
+        if (group.error) {
+            std::rethrow_exception(group.error);
+        }
+    }
+
+    bool WorkStealingPool::TryRunOne(size_t index) {
+        Task task;
+        if (index < queues_.size()) {
+            std::lock_guard lock(queues_[index]->mutex);
+            if (!queues_[index]->tasks.empty()) {
+                task = std::move(queues_[index]->tasks.back());
+                queues_[index]->tasks.pop_back();
+            }
+        }
+        for (size_t i = 1; !task && i <= queues_.size(); ++i) {
+            WorkerQueue& victim = *queues_[(index + i) % queues_.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+        if (!task) {
+            return false;
+        }
+        --pending_;
+        task();
+        return true;
+    }
+
+    void WorkStealingPool::WorkerLoop(size_t index) {
+        while (true) {
+            if (TryRunOne(index)) {
+                continue;
+            }
+            std::unique_lock lock(wake_mutex_);
+            wake_cv_.wait(lock, [this] {
+                return stop_ || pending_ > 0;
+            });
+            if (stop_) {
+                return;
+            }
+        }
+    }
+
+} // namespace concurrency
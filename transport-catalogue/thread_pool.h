@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace concurrency {
+
+    // Fixed set of threads, each with its own task deque. A worker takes tasks from the
+    // back of its own deque and, when that is empty, steals from the front of the others,
+    // so uneven chunks (a slow Map among cheap Stop requests) do not leave threads idle
+    class WorkStealingPool {
+    public:
+        // 0 means one thread per hardware thread
+        explicit WorkStealingPool(size_t thread_count = 0);
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+        ~WorkStealingPool();
+
+        size_t GetThreadCount() const {
+            return threads_.size();
+        }
+
+        // Calls body(begin, end) for consecutive chunks of at most grain indices covering
+        // [0, count) and returns once all of them are done. The calling thread helps.
+        // The first exception thrown by body is rethrown here after the rest finish
+        void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    private:
+        using Task = std::function<void()>;
+
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void WorkerLoop(size_t index);
+        // Runs one task from queue index or, failing that, one stolen from another queue
+        bool TryRunOne(size_t index);
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues_;
+        std::vector<std::thread> threads_;
+        std::atomic<size_t> pending_ = 0;
+        std::mutex wake_mutex_;
+        std::condition_variable wake_cv_;
+        bool stop_ = false;
+    };
+
+} // namespace concurrency
@@ -1,21 +1,58 @@
 #include "transport_catalogue.h"
+#include "profile.h"
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
 #include <unordered_set>
 using namespace std;
 
 namespace transport_catalogue {
 
+	void TransportCatalogue::ThrowIfFrozen() const {
+		if (view_) {
+			throw logic_error("The catalogue is frozen"s);
+		}
+	}
+
+	const CatalogueView& TransportCatalogue::Freeze() {
+		ThrowIfFrozen();
+		view_ = make_unique<const CatalogueView>(*this);
+		return *view_;
+	}
+
+	const CatalogueView& TransportCatalogue::GetView() const {
+		if (!view_) {
+			throw logic_error("The catalogue is not frozen yet"s);
+		}
+		return *view_;
+	}
+
+	void TransportCatalogue::Reserve(size_t stop_count, size_t distance_count) {
+		ThrowIfFrozen();
+		stop_coordinates_.Reserve(stop_count);
+		distances_.reserve(distance_count);
+	}
+
 	void TransportCatalogue::AddStop(const string& name, geo::Coordinates coords) {
-		Stop& stop_in_deque = *(stops_.insert(stops_.end(), { name, coords }));
+		ThrowIfFrozen();
+		Stop& stop_in_deque = *(stops_.insert(stops_.end(), { name, coords, stops_.size() }));
+		stop_coordinates_.Add(coords);
 		stopname_to_stop_.insert({ stop_in_deque.name, &stop_in_deque });
 	}
 
-	void TransportCatalogue::AddBus(const string& name, const vector<string>& stops, bool is_circled) {
+	void TransportCatalogue::AddBus(const string& name, const vector<string_view>& stops, bool is_circled) {
+		ThrowIfFrozen();
 		vector<const Stop*> stop_ptrs;
+		stop_ptrs.reserve(stops.size());
 		for (const auto& stop_name : stops) {
 			stop_ptrs.push_back(stopname_to_stop_.at(stop_name));
 		}
-		Bus& bus_in_deque = *(buses_.insert(buses_.end(), { name, stop_ptrs, is_circled }));
+		AddBus(name, move(stop_ptrs), is_circled);
+	}
+
+	void TransportCatalogue::AddBus(const string& name, vector<const Stop*> stop_ptrs, bool is_circled) {
+		ThrowIfFrozen();
+		Bus& bus_in_deque = *(buses_.insert(buses_.end(), { name, move(stop_ptrs), is_circled, buses_.size() }));
 		busname_to_bus_.insert({ bus_in_deque.name, &bus_in_deque });
 
 		for (const auto& stop : bus_in_deque.stops) {
@@ -23,67 +60,104 @@ namespace transport_catalogue {
 		}
 	}
 
-	void TransportCatalogue::SetDistance(const string& from, const string& to, int distance) {
-		pair<const Stop*, const Stop*> stop_pair = { stopname_to_stop_.at(from), stopname_to_stop_.at(to) };
-		distances_.insert({ stop_pair, distance });
+	void TransportCatalogue::SetDistance(string_view from, string_view to, int distance) {
+		ThrowIfFrozen();
+		SetDistance(stopname_to_stop_.at(from), stopname_to_stop_.at(to), distance);
+	}
+
+	void TransportCatalogue::SetDistance(const Stop* from, const Stop* to, int distance) {
+		ThrowIfFrozen();
+		distances_.insert({ { from, to }, static_cast<double>(distance) });
 	}
 
 	void TransportCatalogue::SetRoutingSettings(RoutingSettings rt) {
+		ThrowIfFrozen();
 		routing_settings_ = rt;
 	}
 
 	void TransportCatalogue::SetRenderSettings(map_renderer::detail::RenderSettings&& settings) {
+		ThrowIfFrozen();
 		render_settings_ = std::move(settings);
 	}
 
 	void TransportCatalogue::SetGraph(Graph&& graph) {
+		ThrowIfFrozen();
 		graph_ = std::move(graph);
 	}
 
 	void TransportCatalogue::BuildGraph() {
+		ThrowIfFrozen();
 		graph_ = graph::DirectedWeightedGraph<double>(stops_.size());
+		vector<graph::Edge<double>> edges;
 		for (const Bus& bus : buses_) {
-			size_t current_bus_stops_count = (bus.stops).size();
-			for (size_t i = 0; i < current_bus_stops_count; ++i) {
-				const Stop* ith_stop_ptr = bus.stops[i];
-				graph::EdgeId ith_stop_id = distance(stops_.begin(), find(stops_.begin(), stops_.end(), *ith_stop_ptr));
-				double distance_forward = 0.0;
-				double distance_backward = 0.0;
-			 	for (size_t j = i + 1; j < current_bus_stops_count; ++j) {
-					const Stop* jth_stop_ptr = bus.stops[j];
-					const Stop* prev_jth_stop_ptr = bus.stops[j - 1];
-					distance_forward += GetDistance(prev_jth_stop_ptr->name, jth_stop_ptr->name);
-					graph::EdgeId jth_stop_id = distance(stops_.begin(), find(stops_.begin(), stops_.end(), *jth_stop_ptr));
-					graph_.AddEdge
+			edges.clear();
+			GenerateBusEdges(bus, edges);
+			for (graph::Edge<double>& edge : edges) {
+				graph_.AddEdge(move(edge));
+			}
+		}
+	}
+
+	void TransportCatalogue::BuildGraph(concurrency::WorkStealingPool& pool) {
+		ThrowIfFrozen();
+		graph_ = graph::DirectedWeightedGraph<double>(stops_.size());
+		// Only the distances and settings are read while the buffers are filled
+		vector<vector<graph::Edge<double>>> bus_edges(buses_.size());
+		pool.ParallelFor(buses_.size(), 16, [this, &bus_edges](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				GenerateBusEdges(buses_[i], bus_edges[i]);
+			}
+		});
+		for (vector<graph::Edge<double>>& edges : bus_edges) {
+			for (graph::Edge<double>& edge : edges) {
+				graph_.AddEdge(move(edge));
+			}
+			// Freed as it goes, so the buffers and the graph are not both held whole
+			vector<graph::Edge<double>>().swap(edges);
+		}
+	}
+
+	void TransportCatalogue::GenerateBusEdges(const Bus& bus, vector<graph::Edge<double>>& edges) const {
+		size_t current_bus_stops_count = (bus.stops).size();
+		for (size_t i = 0; i < current_bus_stops_count; ++i) {
+			const Stop* ith_stop_ptr = bus.stops[i];
+			graph::VertexId ith_stop_id = ith_stop_ptr->id;
+			double distance_forward = 0.0;
+			double distance_backward = 0.0;
+			for (size_t j = i + 1; j < current_bus_stops_count; ++j) {
+				const Stop* jth_stop_ptr = bus.stops[j];
+				const Stop* prev_jth_stop_ptr = bus.stops[j - 1];
+				distance_forward += GetDistance(prev_jth_stop_ptr, jth_stop_ptr);
+				graph::VertexId jth_stop_id = jth_stop_ptr->id;
+				edges.push_back
+				({
+					ith_stop_id, jth_stop_id, j - i, bus.name,
+					routing_settings_.bus_wait_time + distance_forward / routing_settings_.bus_velocity * 60 / 1000
+				});
+				if (!bus.is_roundtrip) {
+					distance_backward += GetDistance(jth_stop_ptr, prev_jth_stop_ptr);
+					edges.push_back
 					({
-						ith_stop_id, jth_stop_id, j - i, bus.name,
-						routing_settings_.bus_wait_time + distance_forward / routing_settings_.bus_velocity * 60 / 1000
+						jth_stop_id, ith_stop_id, j - i, bus.name,
+						routing_settings_.bus_wait_time + distance_backward / routing_settings_.bus_velocity * 60 / 1000
 					});
-					if (!bus.is_roundtrip) {
-						distance_backward += GetDistance(jth_stop_ptr->name, prev_jth_stop_ptr->name);
-						graph_.AddEdge
-						({
-							jth_stop_id, ith_stop_id, j - i, bus.name,
-							routing_settings_.bus_wait_time + distance_backward / routing_settings_.bus_velocity * 60 / 1000
-						});
-					}
 				}
 			}
 		}
 	}
 
-	optional<Stop> TransportCatalogue::FindStop(string_view stop_name) const {
-		if (stopname_to_stop_.count(stop_name)) {
-			return *(stopname_to_stop_.at(stop_name));
+	const Stop* TransportCatalogue::FindStop(string_view stop_name) const {
+		if (auto it = stopname_to_stop_.find(stop_name); it != stopname_to_stop_.end()) {
+			return it->second;
 		}
-		return nullopt;
+		return nullptr;
 	}
 
-	optional<Bus> TransportCatalogue::FindBus(string_view bus_name) const {
-		if (busname_to_bus_.count(bus_name)) {
-			return *(busname_to_bus_.at(bus_name));
+	const Bus* TransportCatalogue::FindBus(string_view bus_name) const {
+		if (auto it = busname_to_bus_.find(bus_name); it != busname_to_bus_.end()) {
+			return it->second;
 		}
-		return nullopt;
+		return nullptr;
 	}
 
 	const std::deque<Stop>& TransportCatalogue::GetStops() const {
@@ -99,11 +173,10 @@ namespace transport_catalogue {
 	}
 
 	size_t TransportCatalogue::GetStopIndex(const Stop* stop) const {
-		auto it = find(stops_.begin(), stops_.end(), *stop);
-		return distance(stops_.begin(), it);
+		return stop->id;
 	}
 
-	std::string TransportCatalogue::GetStopnameByIndex(size_t index) const {
+	const std::string& TransportCatalogue::GetStopnameByIndex(size_t index) const {
 		return stops_.at(index).name;
 	}
 
@@ -119,29 +192,33 @@ namespace transport_catalogue {
 		return busname_to_bus_;
 	}
 
-	set<string_view> TransportCatalogue::GetBusesByStop(string_view stop_name) const {
-		if (!stopname_to_busnames_.count(stop_name)) {
-			return {};
+	const set<string_view>& TransportCatalogue::GetBusesByStop(string_view stop_name) const {
+		static const set<string_view> no_buses;
+		if (auto it = stopname_to_busnames_.find(stop_name); it != stopname_to_busnames_.end()) {
+			return it->second;
 		}
-		return stopname_to_busnames_.at(stop_name);
+		return no_buses;
 	}
 
 	double TransportCatalogue::GetDistance(string_view from, string_view to) const {
-		const Stop* from_stop_ptr = stopname_to_stop_.at(from);
-		const Stop* to_stop_ptr = stopname_to_stop_.at(to);
-		if (distances_.count({ from_stop_ptr, to_stop_ptr })) {
-			return distances_.at({ from_stop_ptr, to_stop_ptr });
+		return GetDistance(stopname_to_stop_.at(from), stopname_to_stop_.at(to));
+	}
+
+	double TransportCatalogue::GetDistance(const Stop* from, const Stop* to) const {
+		if (auto it = distances_.find({ from, to }); it != distances_.end()) {
+			return it->second;
 		}
-		return distances_.at({ to_stop_ptr, from_stop_ptr });
+		return distances_.at({ to, from });
 	}
 
 	optional<BusData> TransportCatalogue::GetBusData(string_view bus_name) const {
-		if (!(FindBus(bus_name).has_value())) {
+		const Bus* bus_ptr = FindBus(bus_name);
+		if (!bus_ptr) {
 			return nullopt;
 		}
 
 		BusData result;
-		Bus bus = *(FindBus(bus_name));
+		const Bus& bus = *bus_ptr;
 		size_t stops_count = 0, unique_stops_count = 0;
 		double geo_route_length;
 		size_t real_route_length;
@@ -160,6 +237,57 @@ namespace transport_catalogue {
 		return result;
 	}
 
+	void TransportCatalogue::SetSimplifiedPolylines(vector<vector<uint32_t>> kept_stops) {
+		ThrowIfFrozen();
+		simplified_polylines_ = move(kept_stops);
+	}
+
+	void TransportCatalogue::SetStopPoints(vector<svg::Point> stop_points) {
+		ThrowIfFrozen();
+		stop_points_ = move(stop_points);
+	}
+
+	void TransportCatalogue::SetRenderedMap(string svg) {
+		ThrowIfFrozen();
+		rendered_map_ = move(svg);
+	}
+
+	const string& TransportCatalogue::GetRenderedMap(concurrency::WorkStealingPool* pool) const {
+		call_once(rendered_map_once_, [this, pool] {
+			if (rendered_map_) {
+				return;
+			}
+			PROFILE_PHASE(RENDER_MAP);
+			const map_renderer::MapRenderer& map_renderer = GetMapRenderer();
+			string svg;
+			svg::Writer writer(svg);
+			if (pool) {
+				map_renderer.RenderMap(writer, *pool);
+			}
+			else {
+				map_renderer.RenderMap(writer);
+			}
+			rendered_map_ = move(svg);
+		});
+		return *rendered_map_;
+	}
+
+	const map_renderer::MapRenderer& TransportCatalogue::GetMapRenderer() const {
+		call_once(map_renderer_once_, [this] {
+			map_renderer_ = make_unique<map_renderer::MapRenderer>(render_settings_, GetView());
+			if (!simplified_polylines_.empty()) {
+				map_renderer_->SetSimplifiedPolylines(simplified_polylines_);
+			}
+			if (!stop_points_.empty()) {
+				map_renderer_->SetStopPoints(stop_points_);
+			}
+			else {
+				map_renderer_->SetScalingSettings(GetEveryBusPointCoordinates());
+			}
+		});
+		return *map_renderer_;
+	}
+
 	std::vector<geo::Coordinates> TransportCatalogue::GetEveryBusPointCoordinates() const {
 		std::vector<geo::Coordinates> result;
 		for (const auto& [bus_name, bus_ptr] : busname_to_bus_) {
@@ -173,33 +301,35 @@ namespace transport_catalogue {
 	size_t TransportCatalogue::ComputeRealRouteLength(const Bus& bus) const {
 		size_t result = 0;
 		for (size_t i = 0; i < bus.stops.size() - 1; i++) {
-			result += GetDistance(bus.stops[i]->name, bus.stops[i + 1]->name);
+			result += GetDistance(bus.stops[i], bus.stops[i + 1]);
 		}
 		if (bus.is_roundtrip) {
 			for (size_t i = 0; i < bus.stops.size() - 1; i++) {
-				result += GetDistance(bus.stops[i + 1]->name, bus.stops[i]->name);
+				result += GetDistance(bus.stops[i + 1], bus.stops[i]);
 			}
 		}
 		return result;
 	}
 
 	size_t TransportCatalogue::CountUniqueStops(const Bus& bus) const {
-		const vector<const Stop*> stops = bus.stops;
-		size_t unique_stops_count = 0;
-		unordered_set<string> unique_stops;
+		// Reused between calls, so counting does not allocate on the request path
+		static thread_local vector<const Stop*> unique_stops;
+		unique_stops.assign(bus.stops.begin(), bus.stops.end());
+		sort(unique_stops.begin(), unique_stops.end());
+		return distance(unique_stops.begin(), unique(unique_stops.begin(), unique_stops.end()));
+	}
+
+	double TransportCatalogue::ComputeGeoLength(const vector<const Stop*>& stops) const {
+		static thread_local vector<size_t> path;
+		path.clear();
 		for (const Stop* stop : stops) {
-			if (unique_stops.insert(stop->name).second) {
-				unique_stops_count++;
-			}
+			path.push_back(stop->id);
 		}
-		return unique_stops_count;
+		return stop_coordinates_.ComputeLength(path.data(), path.size());
 	}
 
 	double TransportCatalogue::ComputeGeoRouteLength(const Bus& bus) const {
-		double result = 0;
-		for (size_t i = 0; i < bus.stops.size() - 1; i++) {
-			result += geo::ComputeDistance(bus.stops[i]->coords, bus.stops[i + 1]->coords);
-		}
+		double result = ComputeGeoLength(bus.stops);
 
 		if (bus.is_roundtrip) {
 			result *= 2;
@@ -217,23 +347,20 @@ namespace transport_catalogue {
 	}
 
 	graph::VertexId TransportCatalogue::GetVertexIdByStopName(std::string_view stop_name) const {
-		return distance(stops_.begin(), find_if(stops_.begin(), stops_.end(),
-			[stop_name](const Stop& stop) {return stop.name == string(stop_name); }));
+		return stopname_to_stop_.at(stop_name)->id;
 	}
 
 	std::pair<std::string_view, std::string_view> TransportCatalogue::GetEdgeStops(graph::EdgeId id) const {
-		auto edge = graph_.GetEdge(id);
+		const auto& edge = graph_.GetEdge(id);
 		return { GetStopNameByVertexId(edge.from), GetStopNameByVertexId(edge.to) };
 	}
 	
-	std::string TransportCatalogue::GetEdgeBusName(graph::EdgeId id) const {
-		auto edge = graph_.GetEdge(id);
-		return edge.bus_name;
+	std::string_view TransportCatalogue::GetEdgeBusName(graph::EdgeId id) const {
+		return graph_.GetEdge(id).bus_name;
 	}
 
 	double TransportCatalogue::GetEdgeWeight(graph::EdgeId id) const {
-		auto edge = graph_.GetEdge(id);
-		return edge.weight;
+		return graph_.GetEdge(id).weight;
 	}
 
 	int TransportCatalogue::GetBusWaitingTime() const {
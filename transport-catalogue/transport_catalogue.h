@@ -1,6 +1,7 @@
 #pragma once
 
 #include "geo.h"
+#include "catalogue_view.h"
 #include "domain.h"
 #include "graph.h"
 #include "router.h"
@@ -12,6 +13,8 @@
 #include <deque>
 #include <unordered_map>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
 
@@ -28,47 +31,82 @@ namespace transport_catalogue {
 		};
 	}
 
+	// Filled through the Add and Set methods, then frozen: Freeze builds the CatalogueView that
+	// stat requests are answered from, and any later change throws std::logic_error. The const
+	// methods of a frozen catalogue may be called from any number of threads at once; the
+	// caches, the map renderer and the rendered map, are filled under std::call_once
 	class TransportCatalogue {
 	public:
 		using Route = graph::Router<double>::RouteInfo;
 		using Graph = graph::DirectedWeightedGraph<double>;
 
+		// Sizes the tables for the stops and distances about to be added
+		void Reserve(size_t stop_count, size_t distance_count);
 		void AddStop(const std::string& name, geo::Coordinates coords);
-		void AddBus(const std::string& name, const std::vector<std::string>& stops, bool circled);
+		void AddBus(const std::string& name, const std::vector<std::string_view>& stops, bool circled);
+		// With the stops already looked up; they must be this catalogue's
+		void AddBus(const std::string& name, std::vector<const Stop*> stops, bool circled);
 
-		void SetDistance(const std::string& from, const std::string& to, int distance);
+		void SetDistance(std::string_view from, std::string_view to, int distance);
+		void SetDistance(const Stop* from, const Stop* to, int distance);
 		void SetRoutingSettings(RoutingSettings rt);
 		void SetRenderSettings(map_renderer::detail::RenderSettings&& settings);
 		void SetGraph(Graph&& graph);
+		// Installs a map rendered earlier, e.g. the one stored in the serialized base
+		void SetRenderedMap(std::string svg);
+		// Installs bus lines simplified earlier, see MapRenderer::SetSimplifiedPolylines
+		void SetSimplifiedPolylines(std::vector<std::vector<uint32_t>> kept_stops);
+		// Installs stops projected earlier, so the map renderer skips the projection
+		void SetStopPoints(std::vector<svg::Point> stop_points);
 
 		void BuildGraph(); 
+		// The same graph, with the edges of the buses generated on the pool and added in
+		// bus order, so every edge gets the id the serial build gives it
+		void BuildGraph(concurrency::WorkStealingPool& pool);
 
-		std::optional<Stop> FindStop(std::string_view name) const;
-		std::optional<Bus> FindBus(std::string_view name) const;
+		// Ends filling; returns the view, which lives as long as the catalogue
+		const CatalogueView& Freeze();
+		// Throws std::logic_error unless frozen
+		const CatalogueView& GetView() const;
+
+		const Stop* FindStop(std::string_view name) const;
+		const Bus* FindBus(std::string_view name) const;
 
 		const std::deque<Stop>& GetStops() const;
 		const std::deque<Bus>& GetBuses() const;
 		const std::unordered_map<std::pair<const Stop*, const Stop*>, double, detail::StopPtrPairHahser>& GetDistances() const;
 		size_t GetStopIndex(const Stop* stop) const;
-		std::string GetStopnameByIndex(size_t index) const;
+		const std::string& GetStopnameByIndex(size_t index) const;
 		const map_renderer::detail::RenderSettings& GetRenderSettings() const;
 		const RoutingSettings& GetRoutingSettings() const;
 		const std::map<std::string_view, const Bus*>& GetBusnameToBusMap() const;
-		std::set<std::string_view> GetBusesByStop(std::string_view stop_name) const;
+		const std::set<std::string_view>& GetBusesByStop(std::string_view stop_name) const;
 		double GetDistance(std::string_view from, std::string_view to) const;
+		double GetDistance(const Stop* from, const Stop* to) const;
 		std::optional<BusData> GetBusData(std::string_view bus_name) const;
 		std::vector<geo::Coordinates> GetEveryBusPointCoordinates() const;
 		int GetEdgeSpanCount(graph::EdgeId id) const;
 		std::string_view GetStopNameByVertexId(graph::VertexId id) const;
 		graph::VertexId GetVertexIdByStopName(std::string_view stop_name) const;
 		std::pair<std::string_view, std::string_view> GetEdgeStops(graph::EdgeId id) const;
-		std::string GetEdgeBusName(graph::EdgeId id) const;
+		std::string_view GetEdgeBusName(graph::EdgeId id) const;
 		double GetEdgeWeight(graph::EdgeId id) const;
 		int GetBusWaitingTime() const;
 		const Graph& GetGraphConstRef() const;
+		size_t CountUniqueStops(const Bus& bus) const;
+		// Geographic length of the path through the stops, from the trigonometry
+		// cached for every stop when it was added
+		double ComputeGeoLength(const std::vector<const Stop*>& stops) const;
+		// The map depends only on the base, so it is rendered once, on first use;
+		// if that first call passes a pool, the layers are rendered on it
+		const std::string& GetRenderedMap(concurrency::WorkStealingPool* pool = nullptr) const;
+		// A renderer with the projection and spatial indexes ready, built on first use
+		const map_renderer::MapRenderer& GetMapRenderer() const;
 
 	private:
 		std::deque<Stop> stops_;
+		// Indexed by Stop::id
+		geo::PointArrays stop_coordinates_;
 		std::map<std::string_view, const Stop*> stopname_to_stop_;
 		std::deque<Bus> buses_;
 		std::map<std::string_view, const Bus*> busname_to_bus_;
@@ -77,9 +115,18 @@ namespace transport_catalogue {
 		map_renderer::detail::RenderSettings render_settings_;
 		RoutingSettings routing_settings_;
 		Graph graph_;
+		std::vector<std::vector<uint32_t>> simplified_polylines_;
+		std::vector<svg::Point> stop_points_;
+		std::unique_ptr<const CatalogueView> view_;
+		mutable std::once_flag map_renderer_once_;
+		mutable std::unique_ptr<map_renderer::MapRenderer> map_renderer_;
+		mutable std::once_flag rendered_map_once_;
+		mutable std::optional<std::string> rendered_map_;
 
+		void ThrowIfFrozen() const;
+		// Appends the edges of one bus, in the order BuildGraph adds them
+		void GenerateBusEdges(const Bus& bus, std::vector<graph::Edge<double>>& edges) const;
 		size_t ComputeRealRouteLength(const Bus& bus) const;
-		size_t CountUniqueStops(const Bus& bus) const;
 		double ComputeGeoRouteLength(const Bus& bus) const;
 	};
 